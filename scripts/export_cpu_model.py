@@ -0,0 +1,172 @@
+"""
+导出 cpu 后端(LLM_BACKEND=cpu)使用的模型文件
+
+每层一个文件，post 一个文件，格式为 ax_cpu_model_header_t + bf16 权重，权重顺序见
+src/runner/ax_model_runner/ax_model_runner_cpu.cpp
+
+    # 从 huggingface 权重导出
+    python export_cpu_model.py --hf SmolVLM-256M-Instruct --output smolvlm-256m-cpu
+    # 生成随机权重，用于无权重环境下的性能测试
+    python export_cpu_model.py --random --hidden_size 576 --num_layers 30 --output random-cpu
+"""
+import argparse
+import array
+import os
+import random
+import struct
+
+AX_CPU_MODEL_MAGIC = 0x55504358
+AX_CPU_MODEL_VERSION = 1
+AX_CPU_MODEL_MAX_GROUP = 8
+AX_CPU_MODEL_LAYER = 0
+AX_CPU_MODEL_POST = 1
+AX_CPU_MODEL_FLAG_QKV_BIAS = 1
+
+
+def pack_header(type, flags, cfg):
+    groups = cfg["prefill_groups"]
+    token_num = [g[0] for g in groups] + [0] * (AX_CPU_MODEL_MAX_GROUP - len(groups))
+    kv_cache_num = [g[1] for g in groups] + [0] * (AX_CPU_MODEL_MAX_GROUP - len(groups))
+    return struct.pack(
+        "<12I%dI%dI2f2I" % (AX_CPU_MODEL_MAX_GROUP, AX_CPU_MODEL_MAX_GROUP),
+        AX_CPU_MODEL_MAGIC, AX_CPU_MODEL_VERSION, type, flags,
+        cfg["hidden_size"], cfg["num_heads"], cfg["num_kv_heads"], cfg["head_dim"],
+        cfg["intermediate_size"], cfg["vocab_size"], cfg["kv_cache_num"], len(groups),
+        *token_num, *kv_cache_num,
+        cfg["rope_theta"], cfg["rms_norm_eps"], 0, 0)
+
+
+def random_bf16(n, scale, seed):
+    rng = random.Random(seed)
+    out = array.array("H")
+    for _ in range(n):
+        f = struct.pack("<f", rng.uniform(-scale, scale))
+        out.append(struct.unpack("<I", f)[0] >> 16)
+    return out
+
+
+def ones_bf16(n):
+    return array.array("H", [0x3F80] * n)
+
+
+def write_file(path, header, tensors):
+    with open(path, "wb") as f:
+        f.write(header)
+        for t in tensors:
+            if hasattr(t, "tobytes"):
+                f.write(t.tobytes())
+            else:
+                t.tofile(f)
+    print("write", path)
+
+
+def export_random(args, cfg):
+    H, I = cfg["hidden_size"], cfg["intermediate_size"]
+    q = cfg["num_heads"] * cfg["head_dim"]
+    kv = cfg["num_kv_heads"] * cfg["head_dim"]
+    for l in range(args.num_layers):
+        s = l * 16
+        tensors = [ones_bf16(H),
+                   random_bf16(q * H, H ** -0.5, s + 1),
+                   random_bf16(kv * H, H ** -0.5, s + 2),
+                   random_bf16(kv * H, H ** -0.5, s + 3),
+                   random_bf16(H * q, q ** -0.5, s + 4),
+                   ones_bf16(H),
+                   random_bf16(I * H, H ** -0.5, s + 5),
+                   random_bf16(I * H, H ** -0.5, s + 6),
+                   random_bf16(H * I, I ** -0.5, s + 7)]
+        write_file(os.path.join(args.output, args.layer_template % l), pack_header(AX_CPU_MODEL_LAYER, 0, cfg), tensors)
+    write_file(os.path.join(args.output, "llama_post.axcpu"), pack_header(AX_CPU_MODEL_POST, 0, cfg),
+               [ones_bf16(H), random_bf16(cfg["vocab_size"] * H, H ** -0.5, 7777)])
+    write_file(os.path.join(args.output, "model.embed_tokens.weight.bfloat16.bin"), b"",
+               [random_bf16(cfg["vocab_size"] * H, 1.0, 8888)])
+
+
+def export_hf(args, cfg):
+    import torch
+    from transformers import AutoModelForCausalLM
+
+    def bf16(t):
+        return t.detach().to(torch.bfloat16).contiguous().view(torch.int16).numpy()
+
+    model = AutoModelForCausalLM.from_pretrained(args.hf, torch_dtype=torch.float32, trust_remote_code=True)
+    lm = model.model if hasattr(model, "model") else model
+    if hasattr(lm, "text_model"):
+        lm = lm.text_model
+    layers = lm.layers
+    bias = layers[0].self_attn.q_proj.bias is not None
+    flags = AX_CPU_MODEL_FLAG_QKV_BIAS if bias else 0
+    for l, layer in enumerate(layers):
+        att, mlp = layer.self_attn, layer.mlp
+        tensors = [bf16(layer.input_layernorm.weight), bf16(att.q_proj.weight)]
+        if bias:
+            tensors.append(bf16(att.q_proj.bias))
+        tensors.append(bf16(att.k_proj.weight))
+        if bias:
+            tensors.append(bf16(att.k_proj.bias))
+        tensors.append(bf16(att.v_proj.weight))
+        if bias:
+            tensors.append(bf16(att.v_proj.bias))
+        tensors += [bf16(att.o_proj.weight), bf16(layer.post_attention_layernorm.weight),
+                    bf16(mlp.gate_proj.weight), bf16(mlp.up_proj.weight), bf16(mlp.down_proj.weight)]
+        write_file(os.path.join(args.output, args.layer_template % l), pack_header(AX_CPU_MODEL_LAYER, flags, cfg), tensors)
+    write_file(os.path.join(args.output, "llama_post.axcpu"), pack_header(AX_CPU_MODEL_POST, 0, cfg),
+               [bf16(lm.norm.weight), bf16(model.get_output_embeddings().weight)])
+    write_file(os.path.join(args.output, "model.embed_tokens.weight.bfloat16.bin"), b"",
+               [bf16(lm.embed_tokens.weight)])
+
+
+def hf_config(path):
+    from transformers import AutoConfig
+    c = AutoConfig.from_pretrained(path, trust_remote_code=True)
+    c = getattr(c, "text_config", None) or getattr(c, "llm_config", None) or c
+    return dict(hidden_size=c.hidden_size,
+                num_heads=c.num_attention_heads,
+                num_kv_heads=getattr(c, "num_key_value_heads", c.num_attention_heads),
+                head_dim=getattr(c, "head_dim", None) or c.hidden_size // c.num_attention_heads,
+                intermediate_size=c.intermediate_size,
+                vocab_size=c.vocab_size,
+                rope_theta=getattr(c, "rope_theta", 10000.0),
+                rms_norm_eps=c.rms_norm_eps), c.num_hidden_layers
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--hf", type=str, default="", help="huggingface model dir")
+    parser.add_argument("--random", action="store_true", help="random weights")
+    parser.add_argument("--output", type=str, required=True)
+    parser.add_argument("--layer_template", type=str, default="llama_p128_l%d_together.axcpu")
+    parser.add_argument("--kv_cache_num", type=int, default=1023)
+    parser.add_argument("--prefill", type=str, default="128:0",
+                        help="prefill groups, token_num:kv_cache_num, comma separated. e.g. 128:0,128:1023")
+    # --random
+    parser.add_argument("--num_layers", type=int, default=30)
+    parser.add_argument("--hidden_size", type=int, default=576)
+    parser.add_argument("--num_heads", type=int, default=9)
+    parser.add_argument("--num_kv_heads", type=int, default=3)
+    parser.add_argument("--intermediate_size", type=int, default=1536)
+    parser.add_argument("--vocab_size", type=int, default=49280)
+    args = parser.parse_args()
+
+    os.makedirs(args.output, exist_ok=True)
+    groups = [tuple(int(v) for v in g.split(":")) for g in args.prefill.split(",")]
+    if args.hf:
+        cfg, args.num_layers = hf_config(args.hf)
+    else:
+        cfg = dict(hidden_size=args.hidden_size,
+                   num_heads=args.num_heads,
+                   num_kv_heads=args.num_kv_heads,
+                   head_dim=args.hidden_size // args.num_heads,
+                   intermediate_size=args.intermediate_size,
+                   vocab_size=args.vocab_size,
+                   rope_theta=10000.0,
+                   rms_norm_eps=1e-5)
+    cfg["kv_cache_num"] = args.kv_cache_num
+    cfg["prefill_groups"] = groups
+
+    if args.hf:
+        export_hf(args, cfg)
+    elif args.random:
+        export_random(args, cfg)
+    else:
+        parser.error("--hf or --random")
@@ -0,0 +1,96 @@
+"""
+生成 ax_shim (LLM_USE_AX_SHIM=ON) 使用的模型描述文件
+
+ax_shim 不做计算，模型文件只是 json，描述每个 group 的输入输出和推理耗时，
+tensor 约定和 axmodel 相同: group 0 为 decode，group 1.. 为 prefill
+
+    python gen_ax_shim_model.py --output shim-qwen2-0.5b --num_layers 24 --hidden_size 896 \\
+        --kv_size 128 --vocab_size 151936 --decode_us 520 --prefill_us 9000 --post_us 2400
+
+运行时的接口耗时(MemAlloc/cache/CreateHandle 等)由环境变量 AX_SHIM_CONFIG 指定的 json 配置:
+
+    {"spin": true, "stats": true, "fill": "random", "cache_us": 2, "cache_ns_per_kb": 40,
+     "mem_alloc_us": 30, "create_handle_us": 2000, "create_handle_ns_per_kb": 100, "cmm_size_mb": 4096}
+"""
+import argparse
+import json
+import os
+
+
+def tensor(name, shape, dtype="bf16", range=None):
+    t = {"name": name, "shape": shape, "dtype": dtype}
+    if range is not None:
+        t["range"] = range
+    return t
+
+
+def layer_desc(args, name, groups):
+    descs = []
+    for token_num, history, latency in [(1, args.kv_cache_num, args.decode_us)] + groups:
+        inputs = [tensor("indices", [1, token_num], "uint32")]
+        # 没有历史 kv 的 prefill group 不带 K_cache/V_cache 输入
+        if history > 0:
+            inputs += [tensor("K_cache", [1, history, args.kv_size]),
+                       tensor("V_cache", [1, history, args.kv_size])]
+        inputs += [tensor("input", [1, token_num, args.hidden_size]),
+                   tensor("mask", [1, token_num, history + token_num])]
+        descs.append({
+            "latency_us": latency,
+            "inputs": inputs,
+            "outputs": [tensor("K_cache_out", [1, token_num, args.kv_size]),
+                        tensor("V_cache_out", [1, token_num, args.kv_size]),
+                        tensor("output", [1, token_num, args.hidden_size])],
+        })
+    return {"name": name, "weight_bytes": int(args.layer_weight_mb * 1024 * 1024), "groups": descs}
+
+
+def post_desc(args):
+    return {"name": "llama_post",
+            "weight_bytes": args.hidden_size * args.vocab_size * 2,
+            "groups": [{"latency_us": args.post_us,
+                        "inputs": [tensor("input", [1, 1, args.hidden_size])],
+                        "outputs": [tensor("output", [1, 1, args.vocab_size]),
+                                    tensor("indices", [1, 1], "int32", [0, args.vocab_size])]}]}
+
+
+def write_json(path, desc):
+    with open(path, "w") as f:
+        json.dump(desc, f, indent=1)
+    print("write", path)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--output", type=str, required=True)
+    parser.add_argument("--layer_template", type=str, default="llama_p128_l%d_together.axmodel")
+    parser.add_argument("--post", type=str, default="llama_post.axmodel")
+    parser.add_argument("--embed", type=str, default="model.embed_tokens.weight.bfloat16.bin",
+                        help="zero filled embed file, empty to skip")
+    parser.add_argument("--num_layers", type=int, default=24)
+    parser.add_argument("--hidden_size", type=int, default=896)
+    parser.add_argument("--kv_size", type=int, default=128, help="num_kv_heads * head_dim")
+    parser.add_argument("--vocab_size", type=int, default=151936)
+    parser.add_argument("--kv_cache_num", type=int, default=1023)
+    parser.add_argument("--prefill", type=str, default="128:0",
+                        help="prefill groups, token_num:kv_cache_num[:latency_us], comma separated")
+    parser.add_argument("--decode_us", type=float, default=0)
+    parser.add_argument("--prefill_us", type=float, default=0, help="default latency of prefill groups")
+    parser.add_argument("--post_us", type=float, default=0)
+    parser.add_argument("--layer_weight_mb", type=float, default=0, help="charged by create_handle_ns_per_kb")
+    args = parser.parse_args()
+
+    groups = []
+    for g in args.prefill.split(","):
+        v = g.split(":")
+        groups.append((int(v[0]), int(v[1]), float(v[2]) if len(v) > 2 else args.prefill_us))
+
+    os.makedirs(args.output, exist_ok=True)
+    for l in range(args.num_layers):
+        name = args.layer_template % l
+        write_json(os.path.join(args.output, name), layer_desc(args, name, groups))
+    write_json(os.path.join(args.output, args.post), post_desc(args))
+    if args.embed:
+        path = os.path.join(args.output, args.embed)
+        with open(path, "wb") as f:
+            f.truncate(args.vocab_size * args.hidden_size * 2)
+        print("write", path)
@@ -9,7 +9,10 @@ class TokenizerGLM3_Http():
         self.tokenizer = AutoTokenizer.from_pretrained("THUDM/chatglm3-6b",
                                                        trust_remote_code=True)
 
-    def encode(self, prompt):
+    # b_continue: 接在会话之后，不再加 [gMASK]sop 前缀
+    def encode(self, prompt, b_continue=False):
+        if b_continue:
+            return self.tokenizer.build_single_message("user", "", prompt) + [self.tokenizer.get_command("<|assistant|>")]
         token_ids = self.tokenizer.build_chat_input(
             prompt)["input_ids"][0].tolist()
         return token_ids
@@ -72,7 +75,10 @@ class Request(BaseHTTPRequestHandler):
         if self.path == '/encode':
             req = json.loads(data)
             prompt = req['text']
-            token_ids = tikenizer.encode(prompt)
+            b_continue = False
+            if 'continue' in req:
+                b_continue = req['continue']
+            token_ids = tikenizer.encode(prompt, b_continue)
             if token_ids is None:
                 msg = json.dumps({'token_ids': -1})
             else:
@@ -13,13 +13,18 @@ class Tokenizer_Http():
                                                        trust_remote_code=True,
                                                        use_fast=False)
 
-    def encode(self, content):
+    # b_continue: 接在会话之后，上一轮的 <|im_end|> 已经在 kv cache 中，不再加 system prompt
+    def encode(self, content, b_continue=False):
         prompt = f"<|im_start|>system\n你是由上海人工智能实验室联合商汤科技开发的书生多模态大模型，英文名叫InternVL, 是一个有用无害的人工智能助手。<|im_end|><|im_start|>user\n{content}<|im_end|><|im_start|>assistant\n"
+        if b_continue:
+            prompt = f"<|im_start|>user\n{content}<|im_end|><|im_start|>assistant\n"
         input_ids = self.tokenizer.encode(prompt)
         return input_ids
 
-    def encode_vpm(self, content="Please describe the image shortly."):
+    def encode_vpm(self, content="Please describe the image shortly.", b_continue=False):
         prompt = f"<|im_start|>system\n你是由上海人工智能实验室联合商汤科技开发的书生多模态大模型，英文名叫InternVL, 是一个有用无害的人工智能助手。<|im_end|><|im_start|>user\n<img>" + "<IMG_CONTEXT>" * 64 + f"</img>\n{content}<|im_end|><|im_start|>assistant\n"
+        if b_continue:
+            prompt = f"<|im_start|>user\n<img>" + "<IMG_CONTEXT>" * 64 + f"</img>\n{content}<|im_end|><|im_start|>assistant\n"
         input_ids = self.tokenizer.encode(prompt)
         return input_ids
 
@@ -115,10 +120,13 @@ class Request(BaseHTTPRequestHandler):
             b_img_prompt = False
             if 'img_prompt' in req:
                 b_img_prompt = req['img_prompt']
+            b_continue = False
+            if 'continue' in req:
+                b_continue = req['continue']
             if b_img_prompt:
-                token_ids = tokenizer.encode_vpm(prompt)
+                token_ids = tokenizer.encode_vpm(prompt, b_continue)
             else:
-                token_ids = tokenizer.encode(prompt)
+                token_ids = tokenizer.encode(prompt, b_continue)
             if token_ids is None:
                 msg = json.dumps({'token_ids': -1})
             else:
@@ -12,12 +12,13 @@ class TokenizerGLM3_Http():
         # self.tokenizer = AutoTokenizer.from_pretrained("THUDM/chatglm3-6b",
         #                                                trust_remote_code=True)
 
-    def encode(self, prompt):
+    # b_continue: 接在会话之后，不再加 bos
+    def encode(self, prompt, b_continue=False):
         # tokenizer.apply_chat_template(
         #             prompt,
         #             add_generation_prompt=True,
         #             return_tensors="pt")
-        token_ids = self.tokenizer.encode(prompt)
+        token_ids = self.tokenizer.encode(prompt, add_special_tokens=not b_continue)
         return token_ids
 
     def decode(self, token_ids):
@@ -93,11 +94,17 @@ class Request(BaseHTTPRequestHandler):
         if self.path == '/encode':
             req = json.loads(data)
             prompt = req['text']
+            b_continue = False
+            if 'continue' in req:
+                b_continue = req['continue']
 
             template = f"<|begin_of_text|><|start_header_id|>system<|end_header_id|>\n\n用中文回答问题<|eot_id|><|start_header_id|>user<|end_header_id|>\n\n{prompt}<|eot_id|><|start_header_id|>assistant<|end_header_id|>"
+            if b_continue:
+                # 接在会话之后，上一轮的 <|eot_id|> 已经在 kv cache 中，不再加 system prompt
+                template = f"<|start_header_id|>user<|end_header_id|>\n\n{prompt}<|eot_id|><|start_header_id|>assistant<|end_header_id|>"
             print(template)
 
-            token_ids = tokenizer.encode(template)
+            token_ids = tokenizer.encode(template, b_continue)
             if token_ids is None:
                 msg = json.dumps({'token_ids': -1})
             else:
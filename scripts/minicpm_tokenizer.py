@@ -13,7 +13,8 @@ class TokenizerGLM3_Http():
         # self.tokenizer = AutoTokenizer.from_pretrained("THUDM/chatglm3-6b",
         #                                                trust_remote_code=True)
 
-    def encode(self, prompt):
+    # b_continue: 接在会话之后，不再加 bos
+    def encode(self, prompt, b_continue=False):
         # tokenizer.apply_chat_template(
         #             prompt,
         #             add_generation_prompt=True,
@@ -23,7 +24,7 @@ class TokenizerGLM3_Http():
         history.append({"role": "user", "content": prompt})
         history_str = self.tokenizer.apply_chat_template(history, tokenize=False, add_generation_prompt=False)
         print(history_str)
-        token_ids = self.tokenizer.encode(history_str)
+        token_ids = self.tokenizer.encode(history_str, add_special_tokens=not b_continue)
         return token_ids
 
     def decode(self, token_ids):
@@ -98,7 +99,10 @@ class Request(BaseHTTPRequestHandler):
         if self.path == '/encode':
             req = json.loads(data)
             prompt = req['text']
-            token_ids = tokenizer.encode(prompt)
+            b_continue = False
+            if 'continue' in req:
+                b_continue = req['continue']
+            token_ids = tokenizer.encode(prompt, b_continue)
             if token_ids is None:
                 msg = json.dumps({'token_ids': -1})
             else:
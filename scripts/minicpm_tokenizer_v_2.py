@@ -19,7 +19,8 @@ class TokenizerGLM3_Http():
         # self.tokenizer = AutoTokenizer.from_pretrained("THUDM/chatglm3-6b",
         #                                                trust_remote_code=True)
 
-    def encode(self, prompt):
+    # b_continue: 接在会话之后，不再加 bos
+    def encode(self, prompt, b_continue=False):
         # tokenizer.apply_chat_template(
         #             prompt,
         #             add_generation_prompt=True,
@@ -29,15 +30,15 @@ class TokenizerGLM3_Http():
         history.append({"role": "user", "content": prompt})
         history_str = self.tokenizer.apply_chat_template(history, tokenize=False, add_generation_prompt=False)
         print(history_str)
-        token_ids = self.tokenizer.encode(history_str)
+        token_ids = self.tokenizer.encode(history_str, add_special_tokens=not b_continue)
         return token_ids
     
-    def encode_vpm(self, content = "What is in the image?"):
+    def encode_vpm(self, content = "What is in the image?", b_continue=False):
         image_placeholder = self.tokenizer_v2.im_start + self.tokenizer_v2.unk_token * 64 + self.tokenizer_v2.im_end
         prompt = "<用户>"
         prompt += image_placeholder + "\n" + content + "<AI>"
 
-        input_ids = self.tokenizer_v2.encode(prompt)
+        input_ids = self.tokenizer_v2.encode(prompt, add_special_tokens=not b_continue)
         return input_ids
 
     def decode(self, token_ids):
@@ -121,10 +122,13 @@ class Request(BaseHTTPRequestHandler):
             b_img_prompt = False
             if 'img_prompt' in req:
                 b_img_prompt = req['img_prompt']
+            b_continue = False
+            if 'continue' in req:
+                b_continue = req['continue']
             if b_img_prompt:
-                token_ids = tokenizer.encode_vpm(prompt)
+                token_ids = tokenizer.encode_vpm(prompt, b_continue)
             else:
-                token_ids = tokenizer.encode(prompt)
+                token_ids = tokenizer.encode(prompt, b_continue)
             if token_ids is None:
                 msg = json.dumps({'token_ids': -1})
             else:
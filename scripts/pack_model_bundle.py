@@ -0,0 +1,155 @@
+"""
+把一个模型的所有文件(各层 axmodel、post、vpm、embed)打包成 main --bundle 使用的单文件
+
+    python pack_model_bundle.py --output qwen2.5-0.5b.axllm \\
+        --template_filename_axmodel qwen2.5-0.5b-ax650/qwen2_p128_l%d_together.axmodel --axmodel_num 24 \\
+        --filename_post_axmodel qwen2.5-0.5b-ax650/qwen2_post.axmodel \\
+        --filename_tokens_embed qwen2.5-0.5b-ax650/model.embed_tokens.weight.bfloat16.bin \\
+        --tokens_embed_num 151936 --tokens_embed_size 896 \\
+        --tokenizer_type 2 --filename_tokenizer_model http://127.0.0.1:12345 --bos 0 --eos 0
+
+    python pack_model_bundle.py --list qwen2.5-0.5b.axllm    # 列出内容并校验 crc32
+
+格式(小端)见 src/runner/utils/model_bundle.hpp:
+    header(48B) | entry table(72B x N) | meta json | payload ... 每个 payload 按 --align 对齐
+meta 的字段名和 LLMAttrType 的成员一致，加载时覆盖命令行中对应的参数
+"""
+import argparse
+import json
+import os
+import struct
+import zlib
+
+MAGIC = b"AXLLMPKG"
+VERSION = 1
+NAME_LEN = 48
+HEADER = struct.Struct("<8sIIQQQII")
+ENTRY = struct.Struct("<%dsQQII" % NAME_LEN)
+
+
+def align_up(n, align):
+    return (n + align - 1) // align * align
+
+
+def collect(args):
+    files = [("embed", args.filename_tokens_embed)]
+    for i in range(args.axmodel_num):
+        files.append(("layer.%d" % i, args.template_filename_axmodel % i))
+    files.append(("post", args.filename_post_axmodel))
+    if args.filename_vpm_resampler_axmodedl:
+        if args.vpm_two_stage:
+            files.append(("vpm_encoder", args.filename_vpm_encoder_axmodedl))
+        files.append(("vpm_resampler", args.filename_vpm_resampler_axmodedl))
+    for name, path in files:
+        if not os.path.isfile(path):
+            raise SystemExit("%s: %s not found" % (name, path))
+    return files
+
+
+def pack(args):
+    files = collect(args)
+    embed_bytes = os.path.getsize(args.filename_tokens_embed)
+    if embed_bytes != args.tokens_embed_num * args.tokens_embed_size * 2:
+        raise SystemExit("embed size %d != tokens_embed_num * tokens_embed_size * 2" % embed_bytes)
+
+    meta = {
+        "axmodel_num": args.axmodel_num,
+        "tokens_embed_num": args.tokens_embed_num,
+        "tokens_embed_size": args.tokens_embed_size,
+        "img_token_id": args.img_token_id,
+        "tokenizer_type": args.tokenizer_type,
+        "filename_tokenizer_model": args.filename_tokenizer_model,
+        "b_bos": bool(args.bos),
+        "b_eos": bool(args.eos),
+        "b_vpm_two_stage": bool(args.vpm_two_stage),
+    }
+    meta_bytes = json.dumps(meta, indent=1).encode()
+
+    table_offset = HEADER.size
+    meta_offset = table_offset + ENTRY.size * len(files)
+    offset = align_up(meta_offset + len(meta_bytes), args.align)
+    entries = []
+    for name, path in files:
+        size = os.path.getsize(path)
+        entries.append([name, path, offset, size, 0])
+        offset = align_up(offset + size, args.align)
+
+    with open(args.output, "wb") as f:
+        f.write(b"\0" * entries[0][2])
+        for e in entries:
+            f.seek(e[2])
+            crc = 0
+            with open(e[1], "rb") as src:
+                while True:
+                    chunk = src.read(16 << 20)
+                    if not chunk:
+                        break
+                    crc = zlib.crc32(chunk, crc)
+                    f.write(chunk)
+            e[4] = crc
+            print("%-16s %10.2f MB  %s" % (e[0], e[3] / 1024 / 1024, e[1]))
+        # 最后一个 payload 也补齐，整个文件是 align 的整数倍
+        f.truncate(offset)
+
+        f.seek(0)
+        f.write(HEADER.pack(MAGIC, VERSION, len(entries), table_offset, meta_offset, len(meta_bytes), args.align, 0))
+        for name, _, off, size, crc in entries:
+            f.write(ENTRY.pack(name.encode(), off, size, crc, 0))
+        f.write(meta_bytes)
+    print("write %s, %d entries, %.2f MB" % (args.output, len(entries), offset / 1024 / 1024))
+
+
+def list_bundle(path):
+    ok = True
+    with open(path, "rb") as f:
+        magic, version, num, table_offset, meta_offset, meta_size, align, _ = HEADER.unpack(f.read(HEADER.size))
+        if magic != MAGIC or version != VERSION:
+            raise SystemExit("%s: not a model bundle" % path)
+        f.seek(table_offset)
+        entries = [ENTRY.unpack(f.read(ENTRY.size)) for _ in range(num)]
+        f.seek(meta_offset)
+        print(f.read(meta_size).decode())
+        for name, off, size, crc, _ in entries:
+            f.seek(off)
+            remain, value = size, 0
+            while remain > 0:
+                chunk = f.read(min(remain, 16 << 20))
+                if not chunk:
+                    break
+                value = zlib.crc32(chunk, value)
+                remain -= len(chunk)
+            match = remain == 0 and value == crc
+            ok = ok and match
+            print("%-16s offset %12d %10.2f MB  crc32 %08x %s" % (name.rstrip(b"\0").decode(), off, size / 1024 / 1024, crc,
+                                                                  "ok" if match else "MISMATCH"))
+    if not ok:
+        raise SystemExit("%s: crc32 mismatch" % path)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--list", default="", help="list and verify a bundle instead of packing")
+    parser.add_argument("--output", default="model.axllm")
+    parser.add_argument("--align", type=int, default=4096)
+    parser.add_argument("--template_filename_axmodel", default="")
+    parser.add_argument("--axmodel_num", type=int, default=0)
+    parser.add_argument("--filename_post_axmodel", default="")
+    parser.add_argument("--filename_vpm_encoder_axmodedl", default="")
+    parser.add_argument("--filename_vpm_resampler_axmodedl", default="")
+    parser.add_argument("--vpm_two_stage", type=int, default=0)
+    parser.add_argument("--filename_tokens_embed", default="")
+    parser.add_argument("--tokens_embed_num", type=int, default=0)
+    parser.add_argument("--tokens_embed_size", type=int, default=0)
+    parser.add_argument("--img_token_id", type=int, default=151667)
+    parser.add_argument("--tokenizer_type", type=int, default=0)
+    parser.add_argument("--filename_tokenizer_model", default="tokenizer.model")
+    parser.add_argument("--bos", type=int, default=1)
+    parser.add_argument("--eos", type=int, default=0)
+    args = parser.parse_args()
+
+    if args.list:
+        list_bundle(args.list)
+    else:
+        if args.axmodel_num <= 0 or not args.template_filename_axmodel:
+            raise SystemExit("--template_filename_axmodel and --axmodel_num are required")
+        pack(args)
@@ -77,14 +77,19 @@ class Tokenizer_Http():
                                                        trust_remote_code=True,
                                                        use_fast=False)
 
-    def encode(self, content):
+    # b_continue: 接在会话之后，上一轮的 <end_of_utterance> 已经在 kv cache 中，不再加 <|im_start|>
+    def encode(self, content, b_continue=False):
         prompt = f"<|im_start|>User:{content}<end_of_utterance>\nAssistant:"
+        if b_continue:
+            prompt = f"\nUser:{content}<end_of_utterance>\nAssistant:"
         input_ids = self.tokenizer(prompt)
         return input_ids["input_ids"]
 
-    def encode_vpm(self, content="Can you describe this image?"):
+    def encode_vpm(self, content="Can you describe this image?", b_continue=False):
 
         prompt = f"<|im_start|>User:<image>{content}<end_of_utterance>\nAssistant:"
+        if b_continue:
+            prompt = f"\nUser:<image>{content}<end_of_utterance>\nAssistant:"
         text = [prompt]
         image_rows = [[0]]
         image_cols = [[0]]
@@ -226,10 +231,13 @@ class Request(BaseHTTPRequestHandler):
             b_img_prompt = False
             if 'img_prompt' in req:
                 b_img_prompt = req['img_prompt']
+            b_continue = False
+            if 'continue' in req:
+                b_continue = req['continue']
             if b_img_prompt:
-                token_ids = tokenizer.encode_vpm(prompt)
+                token_ids = tokenizer.encode_vpm(prompt, b_continue)
             else:
-                token_ids = tokenizer.encode(prompt)
+                token_ids = tokenizer.encode(prompt, b_continue)
             if token_ids is None:
                 msg = json.dumps({'token_ids': -1})
             else:
@@ -0,0 +1,693 @@
+/*
+ * ax_sys / ax_engine 模拟库
+ *
+ * 用于在普通 linux 主机上测量 LLM::Run 的 host 端开销(memcpy、cache 维护、查表、采样)，
+ * 以及在确定的时延下测试调度相关的改动。
+ *
+ * - CMM 分配使用对齐的 host 内存，物理地址为单独编号的虚拟地址空间，cache 接口会检查地址范围
+ * - AX_ENGINE_CreateHandle 的模型数据为 json 描述(见 scripts/gen_ax_shim_model.py)，
+ *   只描述每个 group 的输入输出 shape 和该 group 的推理耗时
+ * - 各接口耗时由环境变量 AX_SHIM_CONFIG 指定的 json 配置，默认全部为 0
+ * - 模拟耗时同时累加到虚拟时钟，和主机性能无关，可以用于比较不同的调度
+ */
+#include "ax_sys_api.h"
+#include "ax_engine_api.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <map>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "json.hpp"
+
+#define AX_SHIM_ERR_NULL_PTR 0x80060006
+#define AX_SHIM_ERR_ILLEGAL_PARAM 0x80060007
+#define AX_SHIM_ERR_NOMEM 0x8006000C
+#define AX_SHIM_ERR_UNEXIST 0x80060010
+#define AX_SHIM_ERR_NOT_INIT 0x80060018
+
+#define AX_SHIM_PHY_BASE 0x100000000ULL
+#define AX_SHIM_PHY_GAP 0x1000ULL
+
+#define SHIM_LOGE(fmt, ...) fprintf(stderr, "[ax_shim][E] %s: " fmt "\n", __func__, ##__VA_ARGS__)
+
+namespace
+{
+    enum shim_fill_e
+    {
+        SHIM_FILL_NONE = 0, // 输出保持原样，不产生额外的 cpu 开销
+        SHIM_FILL_ZERO,
+        SHIM_FILL_RANDOM,
+    };
+
+    enum shim_call_e
+    {
+        SHIM_CALL_MEM_ALLOC = 0,
+        SHIM_CALL_MEM_FREE,
+        SHIM_CALL_INVALIDATE,
+        SHIM_CALL_FLUSH,
+        SHIM_CALL_CREATE_HANDLE,
+        SHIM_CALL_DESTROY_HANDLE,
+        SHIM_CALL_RUN,
+        SHIM_CALL_NUM,
+    };
+
+    const char *shim_call_name[SHIM_CALL_NUM] = {
+        "MemAlloc", "MemFree", "MinvalidateCache", "MflushCache", "CreateHandle", "DestroyHandle", "RunGroupIOSync"};
+
+    struct shim_config_t
+    {
+        bool spin = true;
+        bool stats = false;
+        shim_fill_e fill = SHIM_FILL_NONE;
+        double mem_alloc_us = 0;
+        double mem_free_us = 0;
+        double cache_us = 0;
+        double cache_ns_per_kb = 0;
+        double create_handle_us = 0;
+        double create_handle_ns_per_kb = 0;
+        double run_us = 0;
+        unsigned long long cmm_size = 0; // 0 不限制
+    };
+
+    struct shim_stat_t
+    {
+        unsigned long long count = 0;
+        unsigned long long bytes = 0;
+        double charged_us = 0;
+    };
+
+    struct shim_block_t
+    {
+        void *vir;
+        unsigned long long size;
+        bool cached;
+    };
+
+    struct shim_tensor_t
+    {
+        std::string name;
+        std::vector<AX_S32> shape;
+        AX_ENGINE_DATA_TYPE_T dtype;
+        unsigned int elem_size;
+        bool bf16;
+        long long range_lo = 0, range_hi = 0; // 整数输出的随机范围，[lo, hi)
+    };
+
+    struct shim_group_t
+    {
+        std::vector<shim_tensor_t> inputs, outputs;
+        double latency_us = -1;
+
+        std::vector<AX_ENGINE_IOMETA_T> input_meta, output_meta;
+        std::vector<AX_ENGINE_IOMETA_EX_T> input_ex, output_ex;
+        AX_ENGINE_IO_INFO_T info;
+    };
+
+    struct shim_handle_t
+    {
+        std::string name;
+        std::vector<shim_group_t> groups;
+        shim_fill_e fill;
+        unsigned long long run_count = 0;
+        unsigned long long seed = 0;
+    };
+
+    struct shim_state_t
+    {
+        std::mutex lock;
+        bool cfg_loaded = false;
+        bool engine_init = false;
+        shim_config_t cfg;
+
+        std::map<unsigned long long, shim_block_t> blocks; // key 为物理地址
+        unsigned long long next_phy = AX_SHIM_PHY_BASE;
+        unsigned long long cmm_used = 0, cmm_peak = 0;
+
+        unsigned long long handle_seq = 0;
+        shim_stat_t stats[SHIM_CALL_NUM];
+        double virtual_us = 0;
+    };
+
+    shim_state_t &state()
+    {
+        static shim_state_t s;
+        return s;
+    }
+
+    shim_fill_e parse_fill(const std::string &s)
+    {
+        if (s == "zero")
+            return SHIM_FILL_ZERO;
+        if (s == "random")
+            return SHIM_FILL_RANDOM;
+        return SHIM_FILL_NONE;
+    }
+
+    void print_stats_at_exit()
+    {
+        AX_SHIM_PrintStats();
+    }
+
+    void load_config(shim_config_t &cfg)
+    {
+        const char *path = getenv("AX_SHIM_CONFIG");
+        if (path && path[0])
+        {
+            std::ifstream fs(path);
+            if (!fs.is_open())
+            {
+                SHIM_LOGE("open AX_SHIM_CONFIG %s failed, use default", path);
+            }
+            else
+            {
+                try
+                {
+                    nlohmann::json j = nlohmann::json::parse(fs);
+                    cfg.spin = j.value("spin", cfg.spin);
+                    cfg.stats = j.value("stats", cfg.stats);
+                    cfg.fill = parse_fill(j.value("fill", std::string("none")));
+                    cfg.mem_alloc_us = j.value("mem_alloc_us", cfg.mem_alloc_us);
+                    cfg.mem_free_us = j.value("mem_free_us", cfg.mem_free_us);
+                    cfg.cache_us = j.value("cache_us", cfg.cache_us);
+                    cfg.cache_ns_per_kb = j.value("cache_ns_per_kb", cfg.cache_ns_per_kb);
+                    cfg.create_handle_us = j.value("create_handle_us", cfg.create_handle_us);
+                    cfg.create_handle_ns_per_kb = j.value("create_handle_ns_per_kb", cfg.create_handle_ns_per_kb);
+                    cfg.run_us = j.value("run_us", cfg.run_us);
+                    cfg.cmm_size = j.value("cmm_size_mb", 0ULL) * 1024 * 1024;
+                }
+                catch (const std::exception &e)
+                {
+                    SHIM_LOGE("parse AX_SHIM_CONFIG %s failed: %s", path, e.what());
+                }
+            }
+        }
+        const char *stats = getenv("AX_SHIM_STATS");
+        if (stats && stats[0])
+        {
+            cfg.stats = atoi(stats) != 0;
+        }
+        if (cfg.stats)
+        {
+            atexit(print_stats_at_exit);
+        }
+    }
+
+    void ensure_config()
+    {
+        auto &s = state();
+        std::lock_guard<std::mutex> guard(s.lock);
+        if (!s.cfg_loaded)
+        {
+            load_config(s.cfg);
+            s.cfg_loaded = true;
+        }
+    }
+
+    // 按配置的方式等待，spin 的抖动远小于 sleep，适合测微秒级的开销
+    void charge(shim_call_e call, double us, unsigned long long bytes)
+    {
+        auto &s = state();
+        {
+            std::lock_guard<std::mutex> guard(s.lock);
+            s.stats[call].count++;
+            s.stats[call].bytes += bytes;
+            s.stats[call].charged_us += us;
+            s.virtual_us += us;
+        }
+        if (us <= 0)
+            return;
+        auto dur = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::micro>(us));
+        if (s.cfg.spin)
+        {
+            auto end = std::chrono::steady_clock::now() + dur;
+            while (std::chrono::steady_clock::now() < end)
+            {
+            }
+        }
+        else
+        {
+            std::this_thread::sleep_for(dur);
+        }
+    }
+
+    double cache_cost(unsigned long long bytes)
+    {
+        auto &cfg = state().cfg;
+        return cfg.cache_us + cfg.cache_ns_per_kb * (bytes / 1024.0) / 1000.0;
+    }
+
+    // 调用方必须持有锁；检查 [phy, phy + size) 落在同一块已分配的内存内
+    shim_block_t *find_block(unsigned long long phy, unsigned long long size, unsigned long long *block_phy)
+    {
+        auto &blocks = state().blocks;
+        auto it = blocks.upper_bound(phy);
+        if (it == blocks.begin())
+            return nullptr;
+        --it;
+        if (phy + size > it->first + it->second.size)
+            return nullptr;
+        if (block_phy)
+            *block_phy = it->first;
+        return &it->second;
+    }
+
+    AX_S32 mem_alloc(AX_U64 *phyaddr, AX_VOID **pviraddr, AX_U32 size, AX_U32 align, bool cached)
+    {
+        if (!phyaddr || !pviraddr)
+            return AX_SHIM_ERR_NULL_PTR;
+        if (size == 0)
+            return AX_SHIM_ERR_ILLEGAL_PARAM;
+        ensure_config();
+        auto &s = state();
+
+        if (align < 64)
+            align = 64;
+        unsigned long long alloc_size = (size + align - 1) / align * align;
+        // 检查和占用在同一个锁内，并行 init 时几个线程不会同时通过检查而超出 cmm_size
+        {
+            std::lock_guard<std::mutex> guard(s.lock);
+            if (s.cfg.cmm_size && s.cmm_used + alloc_size > s.cfg.cmm_size)
+            {
+                SHIM_LOGE("cmm exhausted, used %llu + %llu > %llu", s.cmm_used, alloc_size, s.cfg.cmm_size);
+                return AX_SHIM_ERR_NOMEM;
+            }
+            s.cmm_used += alloc_size;
+            if (s.cmm_used > s.cmm_peak)
+                s.cmm_peak = s.cmm_used;
+        }
+
+        void *vir = nullptr;
+        if (posix_memalign(&vir, align, alloc_size) != 0)
+        {
+            std::lock_guard<std::mutex> guard(s.lock);
+            s.cmm_used -= alloc_size;
+            return AX_SHIM_ERR_NOMEM;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(s.lock);
+            unsigned long long phy = (s.next_phy + align - 1) / align * align;
+            s.next_phy = phy + alloc_size + AX_SHIM_PHY_GAP;
+            s.blocks[phy] = {vir, alloc_size, cached};
+            *phyaddr = phy;
+            *pviraddr = vir;
+        }
+        charge(SHIM_CALL_MEM_ALLOC, s.cfg.mem_alloc_us, alloc_size);
+        return 0;
+    }
+
+    AX_S32 cache_op(shim_call_e call, AX_U64 phyaddr, AX_VOID *pviraddr, AX_U32 size)
+    {
+        auto &s = state();
+        {
+            std::lock_guard<std::mutex> guard(s.lock);
+            unsigned long long block_phy;
+            auto blk = find_block(phyaddr, size, &block_phy);
+            if (!blk || (char *)blk->vir + (phyaddr - block_phy) != (char *)pviraddr)
+            {
+                SHIM_LOGE("%s phy 0x%llx vir %p size %u not in any cmm block", shim_call_name[call], (unsigned long long)phyaddr, pviraddr, size);
+                return AX_SHIM_ERR_ILLEGAL_PARAM;
+            }
+            // 非 cached 内存不需要维护 cache，和板端一样直接返回
+            if (!blk->cached)
+                return 0;
+        }
+        charge(call, cache_cost(size), size);
+        return 0;
+    }
+
+    unsigned long long xorshift(unsigned long long &x)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x;
+    }
+
+    unsigned short float_to_bf16(float f)
+    {
+        unsigned int u;
+        memcpy(&u, &f, sizeof(u));
+        return (unsigned short)(u >> 16);
+    }
+
+    // 输出内容只用于让上层流程跑通(例如 post 的 indices 给出合法的 token id)，不代表真实结果
+    void fill_output(const shim_tensor_t &t, const AX_ENGINE_IOMETA_T &meta, void *vir, shim_fill_e fill, unsigned long long seed)
+    {
+        if (fill == SHIM_FILL_ZERO)
+        {
+            memset(vir, 0, meta.nSize);
+            return;
+        }
+        unsigned long long x = seed ? seed : 0x9E3779B97F4A7C15ULL;
+        unsigned int count = meta.nSize / t.elem_size;
+        if (t.range_hi > t.range_lo)
+        {
+            unsigned long long span = t.range_hi - t.range_lo;
+            for (unsigned int i = 0; i < count; i++)
+            {
+                long long v = t.range_lo + (long long)(xorshift(x) % span);
+                if (t.elem_size == 4)
+                    ((int *)vir)[i] = (int)v;
+                else if (t.elem_size == 2)
+                    ((short *)vir)[i] = (short)v;
+                else
+                    ((char *)vir)[i] = (char)v;
+            }
+        }
+        else if (t.bf16)
+        {
+            for (unsigned int i = 0; i < count; i++)
+                ((unsigned short *)vir)[i] = float_to_bf16((float)(xorshift(x) >> 40) / (1 << 23) - 1.0f);
+        }
+        else if (t.dtype == AX_ENGINE_DT_FLOAT32)
+        {
+            for (unsigned int i = 0; i < count; i++)
+                ((float *)vir)[i] = (float)(xorshift(x) >> 40) / (1 << 23) - 1.0f;
+        }
+        else
+        {
+            for (unsigned int i = 0; i < meta.nSize; i++)
+                ((unsigned char *)vir)[i] = (unsigned char)xorshift(x);
+        }
+    }
+
+    bool parse_dtype(const std::string &s, shim_tensor_t &t)
+    {
+        static const std::map<std::string, std::pair<AX_ENGINE_DATA_TYPE_T, unsigned int>> dtypes = {
+            {"uint8", {AX_ENGINE_DT_UINT8, 1}},
+            {"int8", {AX_ENGINE_DT_SINT8, 1}},
+            {"uint16", {AX_ENGINE_DT_UINT16, 2}},
+            {"int16", {AX_ENGINE_DT_SINT16, 2}},
+            {"bf16", {AX_ENGINE_DT_UINT16, 2}},
+            {"uint32", {AX_ENGINE_DT_UINT32, 4}},
+            {"int32", {AX_ENGINE_DT_SINT32, 4}},
+            {"float32", {AX_ENGINE_DT_FLOAT32, 4}},
+        };
+        auto it = dtypes.find(s);
+        if (it == dtypes.end())
+            return false;
+        t.dtype = it->second.first;
+        t.elem_size = it->second.second;
+        t.bf16 = s == "bf16";
+        return true;
+    }
+
+    bool parse_tensors(const nlohmann::json &arr, std::vector<shim_tensor_t> &tensors)
+    {
+        for (auto &jt : arr)
+        {
+            shim_tensor_t t;
+            t.name = jt.at("name").get<std::string>();
+            t.shape = jt.at("shape").get<std::vector<AX_S32>>();
+            if (!parse_dtype(jt.value("dtype", std::string("bf16")), t))
+            {
+                SHIM_LOGE("tensor %s unknown dtype %s", t.name.c_str(), jt.value("dtype", std::string()).c_str());
+                return false;
+            }
+            if (jt.contains("range"))
+            {
+                t.range_lo = jt["range"].at(0).get<long long>();
+                t.range_hi = jt["range"].at(1).get<long long>();
+            }
+            tensors.push_back(t);
+        }
+        return true;
+    }
+
+    void build_meta(std::vector<shim_tensor_t> &tensors, std::vector<AX_ENGINE_IOMETA_T> &meta, std::vector<AX_ENGINE_IOMETA_EX_T> &ex)
+    {
+        meta.resize(tensors.size());
+        ex.resize(tensors.size());
+        for (size_t i = 0; i < tensors.size(); i++)
+        {
+            auto &t = tensors[i];
+            memset(&meta[i], 0, sizeof(meta[i]));
+            memset(&ex[i], 0, sizeof(ex[i]));
+            ex[i].eColorSpace = AX_ENGINE_CS_FEATUREMAP;
+            unsigned long long size = t.elem_size;
+            for (auto d : t.shape)
+                size *= d;
+            meta[i].pName = (AX_CHAR *)t.name.c_str();
+            meta[i].pShape = t.shape.data();
+            meta[i].nShapeSize = (AX_U8)t.shape.size();
+            meta[i].eLayout = AX_ENGINE_TENSOR_LAYOUT_NHWC;
+            meta[i].eMemoryType = AX_ENGINE_MT_PHYSICAL;
+            meta[i].eDataType = t.dtype;
+            meta[i].pExtraMeta = &ex[i];
+            meta[i].nSize = (AX_U32)size;
+        }
+    }
+}
+
+AX_S32 AX_SYS_Init(AX_VOID)
+{
+    ensure_config();
+    return 0;
+}
+
+AX_S32 AX_SYS_Deinit(AX_VOID)
+{
+    return 0;
+}
+
+AX_S32 AX_SYS_MemAlloc(AX_U64 *phyaddr, AX_VOID **pviraddr, AX_U32 size, AX_U32 align, const AX_S8 *token)
+{
+    return mem_alloc(phyaddr, pviraddr, size, align, false);
+}
+
+AX_S32 AX_SYS_MemAllocCached(AX_U64 *phyaddr, AX_VOID **pviraddr, AX_U32 size, AX_U32 align, const AX_S8 *token)
+{
+    return mem_alloc(phyaddr, pviraddr, size, align, true);
+}
+
+AX_S32 AX_SYS_MemFree(AX_U64 phyaddr, AX_VOID *pviraddr)
+{
+    auto &s = state();
+    unsigned long long size = 0;
+    {
+        std::lock_guard<std::mutex> guard(s.lock);
+        auto it = s.blocks.find(phyaddr);
+        if (it == s.blocks.end() || it->second.vir != pviraddr)
+        {
+            SHIM_LOGE("phy 0x%llx vir %p not allocated", (unsigned long long)phyaddr, pviraddr);
+            return AX_SHIM_ERR_UNEXIST;
+        }
+        size = it->second.size;
+        free(it->second.vir);
+        s.cmm_used -= size;
+        s.blocks.erase(it);
+    }
+    charge(SHIM_CALL_MEM_FREE, s.cfg.mem_free_us, size);
+    return 0;
+}
+
+AX_S32 AX_SYS_MflushCache(AX_U64 phyaddr, AX_VOID *pviraddr, AX_U32 size)
+{
+    return cache_op(SHIM_CALL_FLUSH, phyaddr, pviraddr, size);
+}
+
+AX_S32 AX_SYS_MinvalidateCache(AX_U64 phyaddr, AX_VOID *pviraddr, AX_U32 size)
+{
+    return cache_op(SHIM_CALL_INVALIDATE, phyaddr, pviraddr, size);
+}
+
+AX_S32 AX_ENGINE_Init(AX_ENGINE_NPU_ATTR_T *pNpuAttr)
+{
+    if (!pNpuAttr)
+        return AX_SHIM_ERR_NULL_PTR;
+    ensure_config();
+    std::lock_guard<std::mutex> guard(state().lock);
+    state().engine_init = true;
+    return 0;
+}
+
+AX_S32 AX_ENGINE_Deinit(AX_VOID)
+{
+    std::lock_guard<std::mutex> guard(state().lock);
+    state().engine_init = false;
+    return 0;
+}
+
+AX_S32 AX_ENGINE_CreateHandle(AX_ENGINE_HANDLE *pHandle, const AX_VOID *pData, AX_U32 nDataSize)
+{
+    if (!pHandle || !pData)
+        return AX_SHIM_ERR_NULL_PTR;
+    auto &s = state();
+    if (!s.engine_init)
+        return AX_SHIM_ERR_NOT_INIT;
+
+    auto handle = new shim_handle_t;
+    unsigned long long weight_bytes = 0;
+    try
+    {
+        nlohmann::json j = nlohmann::json::parse((const char *)pData, (const char *)pData + nDataSize);
+        handle->name = j.value("name", std::string());
+        handle->fill = j.contains("fill") ? parse_fill(j["fill"].get<std::string>()) : s.cfg.fill;
+        weight_bytes = j.value("weight_bytes", 0ULL);
+        for (auto &jg : j.at("groups"))
+        {
+            shim_group_t grp;
+            grp.latency_us = jg.value("latency_us", -1.0);
+            if (!parse_tensors(jg.at("inputs"), grp.inputs) || !parse_tensors(jg.at("outputs"), grp.outputs))
+            {
+                delete handle;
+                return AX_SHIM_ERR_ILLEGAL_PARAM;
+            }
+            handle->groups.push_back(std::move(grp));
+        }
+    }
+    catch (const std::exception &e)
+    {
+        SHIM_LOGE("model is not a shim json description: %s", e.what());
+        delete handle;
+        return AX_SHIM_ERR_ILLEGAL_PARAM;
+    }
+    if (handle->groups.empty())
+    {
+        SHIM_LOGE("model %s has no group", handle->name.c_str());
+        delete handle;
+        return AX_SHIM_ERR_ILLEGAL_PARAM;
+    }
+
+    // groups 不再增删，meta 中的指针指向 groups 内的成员
+    for (auto &grp : handle->groups)
+    {
+        build_meta(grp.inputs, grp.input_meta, grp.input_ex);
+        build_meta(grp.outputs, grp.output_meta, grp.output_ex);
+        memset(&grp.info, 0, sizeof(grp.info));
+        grp.info.pInputs = grp.input_meta.data();
+        grp.info.nInputSize = grp.input_meta.size();
+        grp.info.pOutputs = grp.output_meta.data();
+        grp.info.nOutputSize = grp.output_meta.size();
+        grp.info.nMaxBatchSize = 1;
+        grp.info.bDynamicBatchSize = AX_FALSE;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(s.lock);
+        handle->seed = ++s.handle_seq * 0x2545F4914F6CDD1DULL;
+    }
+    charge(SHIM_CALL_CREATE_HANDLE, s.cfg.create_handle_us + s.cfg.create_handle_ns_per_kb * (weight_bytes / 1024.0) / 1000.0, weight_bytes);
+    *pHandle = handle;
+    return 0;
+}
+
+AX_S32 AX_ENGINE_DestroyHandle(AX_ENGINE_HANDLE nHandle)
+{
+    if (!nHandle)
+        return AX_SHIM_ERR_NULL_PTR;
+    delete (shim_handle_t *)nHandle;
+    charge(SHIM_CALL_DESTROY_HANDLE, 0, 0);
+    return 0;
+}
+
+AX_S32 AX_ENGINE_CreateContext(AX_ENGINE_HANDLE handle)
+{
+    return handle ? 0 : AX_SHIM_ERR_NULL_PTR;
+}
+
+AX_S32 AX_ENGINE_CreateContextV2(AX_ENGINE_HANDLE nHandle, AX_ENGINE_CONTEXT_T *pContext)
+{
+    if (!nHandle || !pContext)
+        return AX_SHIM_ERR_NULL_PTR;
+    // 模拟库没有 context 状态，直接使用 handle
+    *pContext = nHandle;
+    return 0;
+}
+
+AX_S32 AX_ENGINE_GetIOInfo(AX_ENGINE_HANDLE nHandle, AX_ENGINE_IO_INFO_T **pIO)
+{
+    return AX_ENGINE_GetGroupIOInfo(nHandle, 0, pIO);
+}
+
+AX_S32 AX_ENGINE_GetGroupIOInfoCount(AX_ENGINE_HANDLE nHandle, AX_U32 *pCount)
+{
+    if (!nHandle || !pCount)
+        return AX_SHIM_ERR_NULL_PTR;
+    *pCount = ((shim_handle_t *)nHandle)->groups.size();
+    return 0;
+}
+
+AX_S32 AX_ENGINE_GetGroupIOInfo(AX_ENGINE_HANDLE nHandle, AX_U32 nIndex, AX_ENGINE_IO_INFO_T **pIO)
+{
+    if (!nHandle || !pIO)
+        return AX_SHIM_ERR_NULL_PTR;
+    auto handle = (shim_handle_t *)nHandle;
+    if (nIndex >= handle->groups.size())
+        return AX_SHIM_ERR_ILLEGAL_PARAM;
+    *pIO = &handle->groups[nIndex].info;
+    return 0;
+}
+
+AX_S32 AX_ENGINE_RunSync(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_T *pIO)
+{
+    return AX_ENGINE_RunGroupIOSync(handle, handle, 0, pIO);
+}
+
+AX_S32 AX_ENGINE_RunGroupIOSync(AX_ENGINE_HANDLE handle, AX_ENGINE_CONTEXT_T context, AX_U32 nIndex, AX_ENGINE_IO_T *pIO)
+{
+    if (!handle || !pIO)
+        return AX_SHIM_ERR_NULL_PTR;
+    auto h = (shim_handle_t *)handle;
+    if (nIndex >= h->groups.size())
+        return AX_SHIM_ERR_ILLEGAL_PARAM;
+    auto &grp = h->groups[nIndex];
+    if (pIO->nInputSize != grp.info.nInputSize || pIO->nOutputSize != grp.info.nOutputSize)
+    {
+        SHIM_LOGE("%s group %u io count mismatch", h->name.c_str(), nIndex);
+        return AX_SHIM_ERR_ILLEGAL_PARAM;
+    }
+
+    // npu 只认物理地址，检查每个 io 都在已分配的 cmm 范围内
+    unsigned long long bytes = 0;
+    {
+        auto &s = state();
+        std::lock_guard<std::mutex> guard(s.lock);
+        for (AX_U32 i = 0; i < grp.info.nInputSize + grp.info.nOutputSize; i++)
+        {
+            bool is_input = i < grp.info.nInputSize;
+            auto &buf = is_input ? pIO->pInputs[i] : pIO->pOutputs[i - grp.info.nInputSize];
+            auto &meta = is_input ? grp.input_meta[i] : grp.output_meta[i - grp.info.nInputSize];
+            if (!buf.pVirAddr || !find_block(buf.phyAddr, meta.nSize, nullptr))
+            {
+                SHIM_LOGE("%s group %u %s %s phy 0x%llx size %u not in any cmm block", h->name.c_str(), nIndex,
+                          is_input ? "input" : "output", meta.pName, (unsigned long long)buf.phyAddr, meta.nSize);
+                return AX_SHIM_ERR_ILLEGAL_PARAM;
+            }
+            bytes += meta.nSize;
+        }
+    }
+
+    if (h->fill != SHIM_FILL_NONE)
+    {
+        for (AX_U32 i = 0; i < grp.info.nOutputSize; i++)
+        {
+            fill_output(grp.outputs[i], grp.output_meta[i], pIO->pOutputs[i].pVirAddr, h->fill, h->seed + h->run_count * 131 + i);
+        }
+    }
+    h->run_count++;
+
+    charge(SHIM_CALL_RUN, grp.latency_us >= 0 ? grp.latency_us : state().cfg.run_us, bytes);
+    return 0;
+}
+
+AX_VOID AX_SHIM_PrintStats(AX_VOID)
+{
+    auto &s = state();
+    std::lock_guard<std::mutex> guard(s.lock);
+    fprintf(stderr, "[ax_shim] %-18s %10s %14s %14s\n", "call", "count", "bytes", "charged(ms)");
+    for (int i = 0; i < SHIM_CALL_NUM; i++)
+    {
+        fprintf(stderr, "[ax_shim] %-18s %10llu %14llu %14.3f\n", shim_call_name[i], s.stats[i].count, s.stats[i].bytes, s.stats[i].charged_us / 1000.0);
+    }
+    fprintf(stderr, "[ax_shim] cmm used %.2f MB, peak %.2f MB, blocks %zu\n", s.cmm_used / 1048576.0, s.cmm_peak / 1048576.0, s.blocks.size());
+    fprintf(stderr, "[ax_shim] virtual npu/sys time %.3f ms\n", s.virtual_us / 1000.0);
+}
@@ -0,0 +1,28 @@
+/*
+ * ax_sys / ax_engine 模拟库 (ax_shim) 使用的基础类型，与 msp/out/include 中同名头文件保持一致
+ */
+#ifndef _AX_BASE_TYPE_H_
+#define _AX_BASE_TYPE_H_
+
+typedef unsigned long long int AX_U64;
+typedef unsigned int AX_U32;
+typedef unsigned short AX_U16;
+typedef unsigned char AX_U8;
+typedef long long int AX_S64;
+typedef int AX_S32;
+typedef short AX_S16;
+typedef signed char AX_S8;
+typedef char AX_CHAR;
+typedef float AX_F32;
+typedef double AX_F64;
+typedef void AX_VOID;
+
+typedef enum
+{
+    AX_FALSE = 0,
+    AX_TRUE = 1,
+} AX_BOOL;
+
+#define AX_SUCCESS 0
+
+#endif /* _AX_BASE_TYPE_H_ */
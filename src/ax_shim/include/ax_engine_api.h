@@ -0,0 +1,38 @@
+/*
+ * ax_engine 模拟接口，模型为 json 描述文件(见 scripts/gen_ax_shim_model.py)，
+ * 推理不做计算，只按配置的时延模型计时
+ */
+#ifndef _AX_ENGINE_API_H_
+#define _AX_ENGINE_API_H_
+
+#include "ax_engine_type.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    AX_S32 AX_ENGINE_Init(AX_ENGINE_NPU_ATTR_T *pNpuAttr);
+    AX_S32 AX_ENGINE_Deinit(AX_VOID);
+
+    AX_S32 AX_ENGINE_CreateHandle(AX_ENGINE_HANDLE *pHandle, const AX_VOID *pData, AX_U32 nDataSize);
+    AX_S32 AX_ENGINE_DestroyHandle(AX_ENGINE_HANDLE nHandle);
+
+    AX_S32 AX_ENGINE_CreateContext(AX_ENGINE_HANDLE handle);
+    AX_S32 AX_ENGINE_CreateContextV2(AX_ENGINE_HANDLE nHandle, AX_ENGINE_CONTEXT_T *pContext);
+
+    AX_S32 AX_ENGINE_GetIOInfo(AX_ENGINE_HANDLE nHandle, AX_ENGINE_IO_INFO_T **pIO);
+    AX_S32 AX_ENGINE_GetGroupIOInfoCount(AX_ENGINE_HANDLE nHandle, AX_U32 *pCount);
+    AX_S32 AX_ENGINE_GetGroupIOInfo(AX_ENGINE_HANDLE nHandle, AX_U32 nIndex, AX_ENGINE_IO_INFO_T **pIO);
+
+    AX_S32 AX_ENGINE_RunSync(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_T *pIO);
+    AX_S32 AX_ENGINE_RunGroupIOSync(AX_ENGINE_HANDLE handle, AX_ENGINE_CONTEXT_T context, AX_U32 nIndex, AX_ENGINE_IO_T *pIO);
+
+    // ax_shim 专有: 打印各接口的调用次数、字节数和模拟耗时
+    AX_VOID AX_SHIM_PrintStats(AX_VOID);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _AX_ENGINE_API_H_ */
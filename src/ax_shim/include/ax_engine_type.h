@@ -0,0 +1,133 @@
+/*
+ * ax_engine 模拟库使用的类型定义，字段与 msp/out/include/ax_engine_type.h 保持一致
+ */
+#ifndef _AX_ENGINE_TYPE_H_
+#define _AX_ENGINE_TYPE_H_
+
+#include "ax_base_type.h"
+
+typedef AX_VOID *AX_ENGINE_HANDLE;
+typedef AX_VOID *AX_ENGINE_CONTEXT_T;
+
+typedef enum
+{
+    AX_ENGINE_VIRTUAL_NPU_DISABLE = 0,
+    AX_ENGINE_VIRTUAL_NPU_STD = 1,
+    AX_ENGINE_VIRTUAL_NPU_BIG_LITTLE = 2,
+    AX_ENGINE_VIRTUAL_NPU_BUTT
+} AX_ENGINE_NPU_MODE_T;
+
+typedef struct
+{
+    AX_ENGINE_NPU_MODE_T eHardMode;
+    AX_U32 reserve[8];
+} AX_ENGINE_NPU_ATTR_T;
+
+typedef enum
+{
+    AX_ENGINE_DT_UNKNOWN = 0,
+    AX_ENGINE_DT_UINT8 = 1,
+    AX_ENGINE_DT_UINT16 = 2,
+    AX_ENGINE_DT_FLOAT32 = 3,
+    AX_ENGINE_DT_SINT16 = 4,
+    AX_ENGINE_DT_SINT8 = 5,
+    AX_ENGINE_DT_SINT32 = 6,
+    AX_ENGINE_DT_UINT32 = 7,
+    AX_ENGINE_DT_FLOAT64 = 8,
+    AX_ENGINE_DT_UINT10_PACKED = 100,
+    AX_ENGINE_DT_UINT12_PACKED = 101,
+    AX_ENGINE_DT_UINT14_PACKED = 102,
+    AX_ENGINE_DT_UINT16_PACKED = 103,
+} AX_ENGINE_DATA_TYPE_T;
+
+typedef enum
+{
+    AX_ENGINE_CS_FEATUREMAP = 0,
+    AX_ENGINE_CS_RAW8 = 12,
+    AX_ENGINE_CS_RAW10 = 1,
+    AX_ENGINE_CS_RAW12 = 2,
+    AX_ENGINE_CS_RAW14 = 11,
+    AX_ENGINE_CS_RAW16 = 3,
+    AX_ENGINE_CS_NV12 = 4,
+    AX_ENGINE_CS_NV21 = 5,
+    AX_ENGINE_CS_RGB = 6,
+    AX_ENGINE_CS_BGR = 7,
+    AX_ENGINE_CS_RGBA = 8,
+    AX_ENGINE_CS_GRAY = 9,
+    AX_ENGINE_CS_YUV444 = 10,
+} AX_ENGINE_COLOR_SPACE_T;
+
+typedef enum
+{
+    AX_ENGINE_MT_PHYSICAL = 0,
+    AX_ENGINE_MT_VIRTUAL = 1,
+    AX_ENGINE_MT_OCM = 2,
+} AX_ENGINE_MEMORY_TYPE_T;
+
+typedef enum
+{
+    AX_ENGINE_TENSOR_LAYOUT_UNKNOWN = 0,
+    AX_ENGINE_TENSOR_LAYOUT_NHWC = 1,
+    AX_ENGINE_TENSOR_LAYOUT_NCHW = 2,
+} AX_ENGINE_TENSOR_LAYOUT_T;
+
+typedef struct
+{
+    AX_ENGINE_COLOR_SPACE_T eColorSpace;
+    AX_U64 u64Reserved[18];
+} AX_ENGINE_IOMETA_EX_T;
+
+typedef struct
+{
+    AX_CHAR *pName;
+    AX_S32 *pShape;
+    AX_U8 nShapeSize;
+    AX_ENGINE_TENSOR_LAYOUT_T eLayout;
+    AX_ENGINE_MEMORY_TYPE_T eMemoryType;
+    AX_ENGINE_DATA_TYPE_T eDataType;
+    AX_ENGINE_IOMETA_EX_T *pExtraMeta;
+    AX_U32 nSize;
+    AX_U32 nQuantizationValue;
+    AX_S32 *pStride;
+    AX_U64 u64Reserved[9];
+} AX_ENGINE_IOMETA_T;
+
+typedef struct
+{
+    AX_ENGINE_IOMETA_T *pInputs;
+    AX_U32 nInputSize;
+    AX_ENGINE_IOMETA_T *pOutputs;
+    AX_U32 nOutputSize;
+    AX_U32 nMaxBatchSize;
+    AX_BOOL bDynamicBatchSize;
+    AX_U64 u64Reserved[11];
+} AX_ENGINE_IO_INFO_T;
+
+typedef struct
+{
+    AX_U64 phyAddr;
+    AX_VOID *pVirAddr;
+    AX_U32 nSize;
+    AX_S32 *pStride;
+    AX_U8 nStrideSize;
+    AX_U64 u64Reserved[11];
+} AX_ENGINE_IO_BUFFER_T;
+
+typedef struct
+{
+    AX_U32 nWbtIndex;
+    AX_U64 u64Reserved[7];
+} AX_ENGINE_IO_SETTING_T;
+
+typedef struct
+{
+    AX_ENGINE_IO_BUFFER_T *pInputs;
+    AX_U32 nInputSize;
+    AX_ENGINE_IO_BUFFER_T *pOutputs;
+    AX_U32 nOutputSize;
+    AX_U32 nBatchSize;
+    AX_ENGINE_IO_SETTING_T *pIoSetting;
+    AX_U64 u64Reserved[10];
+} AX_ENGINE_IO_T;
+
+#endif /* _AX_ENGINE_TYPE_H_ */
@@ -0,0 +1,9 @@
+/*
+ * ax_ivps 模拟头文件，ax-llm 不使用 ivps 接口
+ */
+#ifndef _AX_IVPS_API_H_
+#define _AX_IVPS_API_H_
+
+#include "ax_base_type.h"
+
+#endif /* _AX_IVPS_API_H_ */
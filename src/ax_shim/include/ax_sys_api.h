@@ -0,0 +1,28 @@
+/*
+ * ax_sys 模拟接口，只实现 ax-llm 用到的 CMM 分配和 cache 维护
+ */
+#ifndef _AX_SYS_API_H_
+#define _AX_SYS_API_H_
+
+#include "ax_base_type.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    AX_S32 AX_SYS_Init(AX_VOID);
+    AX_S32 AX_SYS_Deinit(AX_VOID);
+
+    AX_S32 AX_SYS_MemAlloc(AX_U64 *phyaddr, AX_VOID **pviraddr, AX_U32 size, AX_U32 align, const AX_S8 *token);
+    AX_S32 AX_SYS_MemAllocCached(AX_U64 *phyaddr, AX_VOID **pviraddr, AX_U32 size, AX_U32 align, const AX_S8 *token);
+    AX_S32 AX_SYS_MemFree(AX_U64 phyaddr, AX_VOID *pviraddr);
+
+    AX_S32 AX_SYS_MflushCache(AX_U64 phyaddr, AX_VOID *pviraddr, AX_U32 size);
+    AX_S32 AX_SYS_MinvalidateCache(AX_U64 phyaddr, AX_VOID *pviraddr, AX_U32 size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _AX_SYS_API_H_ */
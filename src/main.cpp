@@ -56,10 +56,13 @@ int main(int argc, char *argv[])
     LLMAttrType attr;
     std::string prompt = "Hi";
     bool b_continue = false;
+    std::string session_path = "";
+    bool b_session_int8 = false;
 
     cmdline::parser cmd;
     cmd.add<std::string>("prompt", 'p', "prompt", true, prompt);
-    cmd.add<std::string>("image", 'i', "image", true);
+    cmd.add<std::string>("image", 'i', "image", false, "");
+    cmd.add<std::string>("bundle", 0, "single file model bundle from pack_model_bundle.py, replaces the model paths and its meta overrides model args", false, attr.bundle_path);
     cmd.add<std::string>("template_filename_axmodel", 0, "axmodel path template", false, attr.template_filename_axmodel);
     cmd.add<std::string>("filename_post_axmodel", 0, "post axmodel path", false, attr.filename_post_axmodel);
     cmd.add<int>("tokenizer_type", 0, "tokenizer type 0:LLaMa 1:Qwen 2:HTTP 3:Phi3 4:MINICPM", false, attr.tokenizer_type);
@@ -67,7 +70,7 @@ int main(int argc, char *argv[])
     cmd.add<std::string>("filename_tokens_embed", 0, "tokens embed path", false, attr.filename_tokens_embed);
 
     cmd.add<std::string>("filename_vpm_encoder_axmodedl", 0, "vpm encoder axmodel path", false, attr.filename_vpm_encoder_axmodedl);
-    cmd.add<std::string>("filename_vpm_resampler_axmodedl", 0, "vpm resampler axmodel path", true, attr.filename_vpm_resampler_axmodedl);
+    cmd.add<std::string>("filename_vpm_resampler_axmodedl", 0, "vpm resampler axmodel path, empty for text only", false, "");
     cmd.add<bool>("vpm_two_stage", 0, "", false, attr.b_vpm_two_stage);
 
     cmd.add<bool>("bos", 0, "", false, attr.b_bos);
@@ -80,19 +83,41 @@ int main(int argc, char *argv[])
     cmd.add<bool>("use_topk", 0, "", false, attr.b_use_topk);
     cmd.add<bool>("use_mmap_load_embed", 0, "it can save os memory", false, attr.b_use_mmap_load_embed);
     cmd.add<bool>("dynamic_load_axmodel_layer", 0, "it can save cmm memory", false, attr.b_dynamic_load_axmodel_layer);
+    cmd.add<int>("dynamic_layer_budget_mb", 0, "cmm budget(MB) for resident layers when dynamic loading, 0 for current and prefetched layers only", false, attr.dynamic_layer_budget_mb);
+    cmd.add<int>("dynamic_layer_prefetch", 0, "number of layers loaded ahead in background when dynamic loading", false, attr.dynamic_layer_prefetch);
+    cmd.add<bool>("compress_layer", 0, "keep layer models lz4 compressed in memory when dynamic loading", false, attr.b_compress_layer);
+    cmd.add<bool>("async_read", 0, "read model and embed files in background with io_uring (threads if unavailable) at init", false, attr.b_async_read);
+    cmd.add<bool>("async_read_direct", 0, "async read with O_DIRECT, bypass page cache", false, attr.b_async_read_direct);
+    cmd.add<int>("async_read_buffer_mb", 0, "max memory(MB) of files read but not yet used at init", false, attr.async_read_buffer_mb);
+    cmd.add<bool>("mmap_populate", 0, "prefault mmap'd embed, layers and bundle at map time", false, attr.b_mmap_populate);
+    cmd.add<bool>("mmap_hugepage", 0, "map files 2MB aligned and advise transparent hugepages", false, attr.b_mmap_hugepage);
+    cmd.add<bool>("mmap_warmup", 0, "read mmap'd embed and dynamic layers into page cache with progress at init", false, attr.b_mmap_warmup);
+    cmd.add<std::string>("meta_cache", 0, "cache of shapes derived from models at init, auto for <layer 0 or bundle>.meta.json, empty to disable", false, attr.meta_cache_path);
+    cmd.add<bool>("lazy_vpm", 0, "init vpm models on first image when vpm size is in meta cache", false, attr.b_lazy_vpm);
+    cmd.add<int>("prefix_cache_mb", 0, "host memory(MB) for kv cache of prompt prefixes shared between sessions, 0 to disable", false, attr.prefix_cache_mb);
+    cmd.add<int>("init_threads", 0, "threads to read model files and create handles in parallel at init", false, attr.init_threads);
 
     cmd.add<bool>("live_print", 0, "print in live if set true, else print in end", false);
 
     cmd.add<bool>("continue", 0, "continuous dialogue", false, b_continue);
-    cmd.add<int>("img_width", 'w', "image width", true);
-    cmd.add<int>("img_height", 'h', "image height", true);
-    cmd.add<unsigned int>("img_token_id", 0, "image token id", false, 151667);  // Default value for InternVL2.5
+    cmd.add<std::string>("session", 0, "restore the dialogue session from this file at start and save it after every turn", false, session_path);
+    cmd.add<bool>("session_int8", 0, "save kv cache of the session as int8", false, b_session_int8);
+    cmd.add<int>("img_width", 'w', "image width", false, attr.vpm_width);
+    cmd.add<int>("img_height", 'h', "image height", false, attr.vpm_height);
+    cmd.add<unsigned int>("img_token_id", 0, "image token id", false, attr.img_token_id);
     cmd.add<std::string>("post_config_path", 0, "post config path", false, attr.post_config_path);
+    cmd.add<std::string>("trace", 0, "ax650 backend: record trace to file, replay backend: trace to replay", false, attr.trace_path);
+    cmd.add<bool>("trace_timing", 0, "replay backend: wait for recorded npu time", false, attr.b_trace_replay_timing);
+    cmd.add<bool>("cache_stats", 0, "print cache maintenance bytes per tensor after each run", false, attr.b_cache_stats);
+    cmd.add<std::string>("io_alloc_policy", 0, "io alloc policy, name=default|cached|uncached|shared, comma separated, post. prefix for post model", false, attr.io_alloc_policy);
+    cmd.add<bool>("io_plan", 0, "alias layer io onto layer 0 buffers, only kv cache is allocated per layer", false, attr.b_io_plan);
+    cmd.add<int>("cmm_arena_mb", 0, "cmm block size(MB) for io buffer pool, 0 to alloc each buffer separately", false, attr.cmm_arena_block_mb);
 
     cmd.parse_check(argc, argv);
 
     prompt = cmd.get<std::string>("prompt");
     auto image_prompt = cmd.get<std::string>("image");
+    attr.bundle_path = cmd.get<std::string>("bundle");
     attr.tokenizer_type = (TokenizerType)cmd.get<int>("tokenizer_type");
     attr.filename_tokenizer_model = cmd.get<std::string>("filename_tokenizer_model");
     attr.filename_tokens_embed = cmd.get<std::string>("filename_tokens_embed");
@@ -113,10 +138,29 @@ int main(int argc, char *argv[])
 
     attr.b_use_mmap_load_embed = cmd.get<bool>("use_mmap_load_embed");
     attr.b_dynamic_load_axmodel_layer = cmd.get<bool>("dynamic_load_axmodel_layer");
+    attr.dynamic_layer_budget_mb = cmd.get<int>("dynamic_layer_budget_mb");
+    attr.dynamic_layer_prefetch = cmd.get<int>("dynamic_layer_prefetch");
+    attr.b_compress_layer = cmd.get<bool>("compress_layer");
+    attr.b_async_read = cmd.get<bool>("async_read");
+    attr.b_async_read_direct = cmd.get<bool>("async_read_direct");
+    attr.async_read_buffer_mb = cmd.get<int>("async_read_buffer_mb");
+    attr.b_mmap_populate = cmd.get<bool>("mmap_populate");
+    attr.b_mmap_hugepage = cmd.get<bool>("mmap_hugepage");
+    attr.b_mmap_warmup = cmd.get<bool>("mmap_warmup");
+    attr.meta_cache_path = cmd.get<std::string>("meta_cache");
+    attr.b_lazy_vpm = cmd.get<bool>("lazy_vpm");
+    attr.prefix_cache_mb = cmd.get<int>("prefix_cache_mb");
+    attr.init_threads = cmd.get<int>("init_threads");
     attr.vpm_width = cmd.get<int>("img_width");
     attr.vpm_height = cmd.get<int>("img_height");
-    unsigned int img_token_id = cmd.get<unsigned int>("img_token_id");
+    attr.img_token_id = cmd.get<unsigned int>("img_token_id");
     attr.post_config_path = cmd.get<std::string>("post_config_path");
+    attr.trace_path = cmd.get<std::string>("trace");
+    attr.b_trace_replay_timing = cmd.get<bool>("trace_timing");
+    attr.b_cache_stats = cmd.get<bool>("cache_stats");
+    attr.io_alloc_policy = cmd.get<std::string>("io_alloc_policy");
+    attr.b_io_plan = cmd.get<bool>("io_plan");
+    attr.cmm_arena_block_mb = cmd.get<int>("cmm_arena_mb");
 
     bool b_live_print = cmd.get<bool>("live_print");
     if (b_live_print)
@@ -126,11 +170,21 @@ int main(int argc, char *argv[])
     }
 
     b_continue = cmd.get<bool>("continue");
+    session_path = cmd.get<std::string>("session");
+    b_session_int8 = cmd.get<bool>("session_int8");
 
     if (!lLaMa.Init(attr))
     {
         return -1;
     }
+    // 模型包的 meta 可能改了 tokenizer 和 img_token_id
+    attr = *lLaMa.getAttr();
+    unsigned int img_token_id = attr.img_token_id;
+
+    if (!session_path.empty() && file_exist(session_path) && lLaMa.LoadSession(session_path))
+    {
+        printf("restore session of %d tokens\n", lLaMa.SessionLength());
+    }
 
     std::vector<unsigned short> prompt_data;
     std::vector<unsigned short> img_embed;
@@ -143,11 +197,19 @@ int main(int argc, char *argv[])
     if (prompt != "")
     {
         std::string output;
-        cv::Mat src = cv::imread(image_prompt, cv::IMREAD_COLOR);
+        cv::Mat src;
+        if (image_prompt != "")
+        {
+            src = cv::imread(image_prompt, cv::IMREAD_COLOR);
+        }
         if (src.empty())
         {
-            // output = lLaMa.Run(prompt);
-            ALOGE("image_prompt can't be empty");
+            if (image_prompt != "")
+            {
+                ALOGE("image prompt(%s) not found", image_prompt.c_str());
+            }
+            lLaMa.Encode(prompt_data, prompt_complete(prompt, attr.tokenizer_type));
+            output = lLaMa.Run(prompt_data);
         }
         else
         {
@@ -158,13 +220,14 @@ int main(int argc, char *argv[])
 
         if (!b_live_print && !output.empty())
             printf("%s\n", output.c_str());
+        if (!session_path.empty())
+            lLaMa.SaveSession(session_path, b_session_int8);
     }
 
     //
     if (b_continue)
     {
-        printf("Type \"q\" to exit, Ctrl+c to stop current running\n");
-        // lLaMa.Reset();
+        printf("Type \"q\" to exit, \"r\" to start a new session, Ctrl+c to stop current running\n");
     }
 
     while (b_continue)
@@ -180,7 +243,13 @@ int main(int argc, char *argv[])
         {
             continue;
         }
-
+        if (prompt == "r")
+        {
+            lLaMa.Reset();
+            if (!session_path.empty())
+                lLaMa.SaveSession(session_path, b_session_int8);
+            continue;
+        }
         printf("image >> ");
         fflush(stdout);
         std::getline(std::cin, image_prompt);
@@ -211,6 +280,8 @@ int main(int argc, char *argv[])
 
         if (!b_live_print)
             printf("%s\n", output.c_str());
+        if (!session_path.empty())
+            lLaMa.SaveSession(session_path, b_session_int8);
     }
 
     lLaMa.Deinit();
@@ -3,21 +3,49 @@
 #include <algorithm>
 #include <cmath>
 #include <numeric>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <sys/stat.h>
 #include "bfloat16.hpp"
 #include "Tokenizer/Tokenizer.hpp"
 #include "LLMEmbedSelector.hpp"
-#include "ax_model_runner/ax_model_runner_ax650.hpp"
 #include "ax_cmm_utils.hpp"
 #include "cqdm.h"
+#include "lz4_block.hpp"
+#include "model_bundle.hpp"
+#include "file_loader.hpp"
+#include "prefix_cache.hpp"
+#include "session_file.hpp"
 #include "timer.hpp"
 #include "opencv2/opencv.hpp"
-#include "ax_sys_api.h"
 #include "LLMPostprocess.hpp"
+#include "LLMLayerLoader.hpp"
+
+#include "ax_model_runner/ax_model_trace.hpp"
+
+#if defined(LLM_BACKEND_CPU)
+#include "ax_model_runner/ax_model_runner_cpu.hpp"
+typedef ax_runner_cpu ax_runner_llm;
+#elif defined(LLM_BACKEND_REPLAY)
+#include "ax_model_runner/ax_model_runner_replay.hpp"
+typedef ax_runner_replay ax_runner_llm;
+#else
+#include "ax_model_runner/ax_model_runner_ax650.hpp"
+#include "ax_model_runner/ax_cmm_arena.hpp"
+typedef ax_runner_ax650 ax_runner_llm;
+#endif
 
 typedef void (*LLMRuningCallback)(int *p_token, int n_token, const char *p_str, float token_per_sec, void *reserve);
 
 struct LLMAttrType
 {
+    // 不为空时从 pack_model_bundle.py 打包的单文件加载，包中的 meta 覆盖下面对应的字段，各模型文件路径不再使用
+    std::string bundle_path = "";
+
     std::string template_filename_axmodel = "tinyllama-int8/tinyllama_l%d.axmodel";
     int axmodel_num = 22;
 
@@ -39,20 +67,66 @@ struct LLMAttrType
     std::string filename_tokens_embed = "tinyllama.model.embed_tokens.weight.bfloat16.bin";
     int tokens_embed_num = 32000;
     int tokens_embed_size = 2048;
+    unsigned int img_token_id = 151667; // InternVL2.5
 
     int max_token_len = 127; // auto calc
 
+    // init 时从模型 io 推出的参数(max_token_len、kv cache、prefill_token_num、vpm 尺寸)缓存到 json 中，按文件大小和修改时间判断是否有效
+    // "auto" 为第 0 层模型(或模型包)旁边的 .meta.json，为空时不使用
+    std::string meta_cache_path = "auto";
+    // 缓存有效时 vpm 推迟到第一次 Encode 图片时再 init
+    bool b_lazy_vpm = true;
+
     int kv_cache_num = 1024; // auto calc
     int kv_cache_size = 256; // auto calc
 
+    // 新会话的输入和之前的输入有相同的前缀(system prompt、对话模板)时，从 host 内存恢复这段前缀各层的 kv，只 prefill 后面的部分
+    // 最多占用的内存(MB)，0 表示不使用
+    int prefix_cache_mb = 0;
+
     bool b_use_mmap_load_embed = false;
     bool b_dynamic_load_axmodel_layer = false;
+    // 动态加载时驻留的层最多占用的 cmm(MB，按模型文件大小估算)，0 表示只保留当前层和预取的层
+    int dynamic_layer_budget_mb = 0;
+    // 推理第 m 层时后台提前加载的层数
+    int dynamic_layer_prefetch = 1;
+    // 动态加载时模型文件用 lz4 压缩后保存在内存中(不使用 mmap)，加载线程解压后再 init
+    bool b_compress_layer = false;
+
+    // init 时并行读取模型文件和创建 handle 的线程数
+    int init_threads = 4;
+    // init 时由后台按使用顺序读入模型和 embed 文件(io_uring，不支持时用线程)，读完直接交给 init
+    bool b_async_read = true;
+    bool b_async_read_direct = false; // O_DIRECT 读，不经过 page cache
+    int async_read_buffer_mb = 256;   // 已读入还没用掉的文件最多占用的内存
 
     bool b_use_mmap_load_layer = true;
+    // mmap 的 embed、动态加载的层和模型包: 映射时就读入(MAP_POPULATE)、使用透明大页
+    bool b_mmap_populate = false;
+    bool b_mmap_hugepage = false;
+    // init 结束前把推理时还会访问的映射逐页读一遍并显示进度，避免推理中缺页
+    bool b_mmap_warmup = false;
 
     bool b_use_topk = false;
     std::string post_config_path = "post_config.json";
 
+    // ax650 后端录制每次推理的输入 hash 和输出，replay 后端从该文件回放
+    std::string trace_path = "";
+    bool b_trace_replay_timing = false; // 回放时按录制的耗时等待
+
+    bool b_cache_stats = false; // 每次 Run 之后打印各 tensor 的 cache 维护字节数
+
+    // io 的分配方式，逗号分隔的 name=policy，policy 为 default/cached/uncached/shared
+    // 默认作用于 decoder 层，post. 前缀作用于 post 模型，例如 "input=cached,indices=cached,post.output=uncached"
+    // shared 只用于 LLM 会绑定到第 0 层的 io(input/output/mask/indices，以及可以零拷贝时的 K_cache_out/V_cache_out)，第 0 层仍然分配
+    std::string io_alloc_policy = "";
+
+    // 第 0 层 init 之后规划层间 io 的生存期，其它层的 input/output/mask/indices(以及可以零拷贝时的 K_cache_out/V_cache_out)不再分配，只保留各自的 kv cache
+    bool b_io_plan = true;
+
+    // ax650 后端 io buffer 从该大小(MB)的 CMM 块中切分，0 表示每个 buffer 单独申请
+    int cmm_arena_block_mb = 16;
+
     // bool b_live_print = true;
     LLMRuningCallback runing_callback = nullptr;
     void *reserve = nullptr;
@@ -63,199 +137,1828 @@ class LLM
 private:
     std::shared_ptr<BaseTokenizer> tokenizer;
     LLaMaEmbedSelector embed_selector;
+    ModelBundle bundle;
+    FileLoader file_loader;
+    std::map<std::string, int> file_loader_index;
 
     LLMAttrType _attr;
 
     struct LLMLayer
     {
-        ax_runner_ax650 layer;
+        ax_runner_llm layer;
         std::string filename;
         MMap layer_buffer;
         std::vector<char> layer_buffer_vec;
+        size_t raw_size = 0; // 不为 0 时 layer_buffer_vec 中是 lz4 压缩后的模型
+        char *bundle_data = nullptr; // 从模型包加载时指向映射的内存
+        size_t bundle_size = 0;
+    };
+
+    // 每层每个 group 在 init 后解析好的 io，推理时直接使用
+    struct LLMLayerIO
+    {
+        const ax_runner_tensor_t *indices = nullptr;
+        const ax_runner_tensor_t *mask = nullptr;
+        const ax_runner_tensor_t *input = nullptr;
+        const ax_runner_tensor_t *k_cache = nullptr;
+        const ax_runner_tensor_t *v_cache = nullptr;
+        const ax_runner_tensor_t *k_cache_out = nullptr;
+        const ax_runner_tensor_t *v_cache_out = nullptr;
+        const ax_runner_tensor_t *output = nullptr;
+        // decode 的 K_cache_out/V_cache_out 直接写入 K_cache/V_cache 的对应行，prefill 的写入开头，省去 cpu 拷贝
+        bool kv_view = false;
+    };
+
+    struct LLMPostIO
+    {
+        const ax_runner_tensor_t *input = nullptr;
+        const ax_runner_tensor_t *output = nullptr;
+        const ax_runner_tensor_t *indices = nullptr;
+        ax_runner_tensor_t own_input; // post 自己分配的 input，最后一层的输出无法直接绑定时使用
+    };
+
+    // 层间 io 的一个值: 第 def 层写入(-1 为推理前由 host 写入)，第 last 层(axmodel_num 为 post)读完之后不再使用
+    struct LLMIOValue
+    {
+        int def;
+        int last;
+        int size;
+        const ax_runner_tensor_t *own;    // 第 0 层中保存该值的 tensor，只有这些 tensor 会被分配
+        const ax_runner_tensor_t *buffer; // 规划结果
+    };
+
+    // 每个 group 的规划结果: act[k] 是第 k 层的输入(第 k - 1 层的输出)，act[axmodel_num] 给 post
+    struct LLMIOPlan
+    {
+        std::vector<const ax_runner_tensor_t *> act;
+        const ax_runner_tensor_t *mask = nullptr;
+        const ax_runner_tensor_t *indices = nullptr;
     };
 
     std::vector<LLMLayer> llama_layers;
-    ax_runner_ax650 llama_post;
+    ax_runner_llm llama_post;
 
-    ax_runner_ax650 vpm_encoder, vpm_resampler;
+    // 模型中除 decode(group 0)外的每个 group: 一次处理 token_num 个 token
+    // history 不为 0 时带 K_cache/V_cache 输入，新的 token 可以接在 kv cache 中已有的(最多 history 个)位置之后
+    struct LLMPrefillGroup
+    {
+        int grpid = 0;
+        int token_num = 0;
+        int history = 0;
+        std::vector<LLMLayerIO> io; // 按层
+        LLMIOPlan plan;
+        double cost_ms = -1; // 一次 prefill 的耗时(滑动平均)，-1 表示还没测到
+    };
+
+    std::vector<LLMLayerIO> decode_io; // 按层连续存放
+    std::vector<LLMPrefillGroup> prefill_groups;
+    std::vector<char> layer_io_ready;
+    LLMPostIO post_io;
+    LLMIOPlan decode_plan;
+
+    ax_runner_llm vpm_encoder, vpm_resampler;
+    bool vpm_ready = false; // b_lazy_vpm 时在第一次 Encode 图片时 init
+
+    LLMLayerLoader layer_loader;
+    std::vector<char> layer_scratch; // 压缩的层解压到这里再 init，只在加载线程(以及 init 时加载第 0 层)使用
 
-    int prefill_grpid = 1;
     int decode_grpid = 0;
 
+    // 多轮对话的会话: kv cache 的前 kv_pos 行有效，decode mask 中这些位置已经打开
+    // pending_token 是上一轮最后采样、还没有送入模型的 token(一般是 eos)，下一轮开头先补上
+    int kv_pos = 0;
+    int pending_token = -1;
+    std::vector<int> session_tokens; // 会话中各轮生成的 token
+
+    // decode 一个 token 经过所有层的耗时(滑动平均)，prefill 分段时用来和 prefill group 比较
+    double decode_cost_ms = -1;
+
+    // 每个节点保存一个位置所有层的 K/V 行: 依次为第 0 层的 K、V，第 1 层的 K、V ...
+    PrefixCache prefix_cache;
+
     // std::vector<std::vector<unsigned short>> k_caches, v_caches;
 
     bool b_stop = false;
 
-    LLMPostprocess postprocess;
-    static int post_process(LLMPostprocess &postprocess, unsigned short *p, int n, std::vector<int> &history, float *val = 0)
+    static void resolve_group_io(ax_runner_llm &runner, int grpid, LLMLayerIO &io)
     {
-        std::vector<float> logits(n);
-        for (int i = 0; i < n; i++)
+        io.indices = runner.find_input(grpid, "indices");
+        io.mask = runner.find_input(grpid, "mask");
+        io.input = runner.find_input(grpid, "input");
+        io.k_cache = runner.find_input(grpid, "K_cache");
+        io.v_cache = runner.find_input(grpid, "V_cache");
+        io.k_cache_out = runner.find_output(grpid, "K_cache_out");
+        io.v_cache_out = runner.find_output(grpid, "V_cache_out");
+        io.output = runner.find_output(grpid, "output");
+    }
+
+    // 层严格顺序执行，按 def 排序贪心分配: 复用生存期已经结束且足够大的 buffer，否则用自己在第 0 层的 tensor 新开一个
+    // 返回 buffer 数，有值分配不到 buffer 时返回 -1
+    static int plan_values(std::vector<LLMIOValue> &values)
+    {
+        std::vector<int> order(values.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b)
+                         { return values[a].def < values[b].def; });
+        std::vector<LLMIOValue *> slots; // 每个 buffer 中最后放入的值
+        for (auto i : order)
         {
-            unsigned int proc = p[i] << 16;
-            logits[i] = *reinterpret_cast<float *>(&proc);
+            auto &v = values[i];
+            v.buffer = nullptr;
+            for (auto &slot : slots)
+            {
+                if (slot->last < v.def && slot->buffer->nSize >= v.size)
+                {
+                    v.buffer = slot->buffer;
+                    slot = &v;
+                    break;
+                }
+            }
+            if (!v.buffer && v.own)
+            {
+                v.buffer = v.own;
+                slots.push_back(&v);
+            }
+            if (!v.buffer)
+            {
+                return -1;
             }
+        }
+        return slots.size();
+    }
 
-        return postprocess.apply(logits, history);
+    // 激活 act[k] 在第 k - 1 层写入、第 k 层读取；mask/indices 推理前写入，所有层只读
+    int plan_group(const LLMLayerIO &io0, LLMIOPlan &plan)
+    {
+        int num = _attr.axmodel_num;
+        std::vector<LLMIOValue> values;
+        for (int k = 0; k <= num; k++)
+        {
+            values.push_back({k - 1, k, io0.input->nSize, k == 0 ? io0.input : (k == 1 ? io0.output : nullptr), nullptr});
+        }
+        values.push_back({-1, num - 1, io0.mask->nSize, io0.mask, nullptr});
+        values.push_back({-1, num - 1, io0.indices->nSize, io0.indices, nullptr});
+        int buffer_num = plan_values(values);
+        if (buffer_num < 0)
+        {
+            return -1;
+        }
+        plan.act.resize(num + 1);
+        for (int k = 0; k <= num; k++)
+        {
+            plan.act[k] = values[k].buffer;
+        }
+        plan.mask = values[num + 1].buffer;
+        plan.indices = values[num + 2].buffer;
+        return buffer_num;
+    }
+
+    // 第 0 层解析之后、其它层 init 之前调用: 除 kv cache 外的层间 io 都放进第 0 层的 buffer，其它层不再分配
+    bool plan_layer_io(std::map<std::string, ax_runner_alloc_policy_e> &layer_policy)
+    {
+        int decode_buffers = plan_group(decode_io[0], decode_plan);
+        int prefill_buffers = 0;
+        for (auto &g : prefill_groups)
+        {
+            int buffers = plan_group(g.io[0], g.plan);
+            if (buffers < 0)
+            {
+                prefill_buffers = -1;
+                break;
+            }
+            prefill_buffers += buffers;
+        }
+        if (decode_buffers < 0 || prefill_buffers < 0)
+        {
+            ALOGE("plan layer io failed");
+            return false;
+        }
+        if (!_attr.b_io_plan || _attr.axmodel_num < 2)
+        {
+            return true;
+        }
 
+        std::vector<std::string> names = {"input", "output", "mask", "indices"};
+        if (decode_io[0].kv_view)
+        {
+            // K_cache_out/V_cache_out 绑定到 kv cache 中
+            names.push_back("K_cache_out");
+            names.push_back("V_cache_out");
+        }
+        std::vector<int> grpids = {decode_grpid};
+        for (auto &g : prefill_groups)
+        {
+            grpids.push_back(g.grpid);
+        }
+        size_t saved = 0;
+        for (auto &name : names)
+        {
+            layer_policy[name] = AX_RUNNER_ALLOC_SHARED;
+            for (auto grpid : grpids)
+            {
+                auto t = llama_layers[0].layer.find_input(grpid, name);
+                t = t ? t : llama_layers[0].layer.find_output(grpid, name);
+                saved += t ? t->nSize : 0;
+            }
+        }
+        for (int i = 1; i < _attr.axmodel_num; i++)
+        {
+            llama_layers[i].layer.set_alloc_policy(layer_policy);
+        }
+        ALOGI("io plan: decode %d buffers, prefill %d buffers(%d groups), save %.2f MB", decode_buffers, prefill_buffers,
+              (int)prefill_groups.size(), saved * (_attr.axmodel_num - 1) / 1024.0 / 1024.0);
+        return true;
     }
 
-public:
-    bool Init(LLMAttrType attr)
+    static bool bind_activation(ax_runner_llm &runner, int grpid, int m, const LLMLayerIO &io, const LLMIOPlan &plan)
     {
-        ALOGI("LLM init start");
-        t_cqdm cqdm = create_cqdm(attr.axmodel_num + 4, 32);
-        this->_attr = attr;
-        tokenizer = CreateTokenizer(attr.tokenizer_type);
-        if (!tokenizer->Init(attr.filename_tokenizer_model, attr.b_bos, attr.b_eos))
+        auto src = plan.act[m];
+        auto dst = plan.act[m + 1];
+        if (io.input->nSize != src->nSize || io.output->nSize > dst->nSize)
         {
-            ALOGE("tokenizer.Init(%s, %d, %d) failed", attr.filename_tokenizer_model.c_str(), attr.b_bos, attr.b_eos);
             return false;
         }
-        update_cqdm(&cqdm, 0, "count", "tokenizer init ok");
-        // test code
-        // {
-        //     std::vector<int> output;
-        //     tokenizer.Encode("Today is National", output);
-        //     // print output
-        //     for (size_t i = 0; i < output.size(); i++)
-        //     {
-        //         printf("%d ", output[i]);
-        //     }
-        //     printf("\n");
-        // }
+        return runner.set_input_buffer(grpid, io.input->nIdx, *src) == 0 &&
+               runner.set_output_buffer(grpid, io.output->nIdx, *dst) == 0;
+    }
 
-        if (!embed_selector.Init(attr.filename_tokens_embed, attr.tokens_embed_num, attr.tokens_embed_size, attr.b_use_mmap_load_embed))
+    // 所有层的 mask/indices 完全相同，每步只更新一份
+    static bool bind_control(ax_runner_llm &runner, int grpid, const LLMLayerIO &io, const LLMIOPlan &plan)
+    {
+        if (io.mask->nSize != plan.mask->nSize || io.indices->nSize != plan.indices->nSize)
         {
-            ALOGE("embed_selector.Init(%s, %d, %d) failed", attr.filename_tokens_embed.c_str(), attr.tokens_embed_num, attr.tokens_embed_size);
             return false;
         }
-        update_cqdm(&cqdm, 1, "count", "embed_selector init ok");
-        // test code
-        // {
-        //     std::vector<unsigned short> embed = embed_selector.getByIndex(123);
-        //     printf("embed size: %d\n", embed.size());
-        //     for (int i = 0; i < embed.size(); i++)
-        //     {
-        //         bfloat16 bf16 = bfloat16(embed[i]);
-        //         float val = bf16;
-        //         printf("%d %0.22f\n", embed[i], val);
-        //     }
-        // }
+        return runner.set_input_buffer(grpid, io.mask->nIdx, *plan.mask) == 0 &&
+               runner.set_input_buffer(grpid, io.indices->nIdx, *plan.indices) == 0;
+    }
 
-        llama_layers.resize(attr.axmodel_num);
-        // prefill_layers.resize(attr.prefill_axmodel_num);
+    // 用最多 threads 个线程执行 tasks，按下标顺序对完成的任务调用 on_done
+    // 有任务失败后不再开始新的任务，等已经开始的任务结束后返回 false
+    static bool run_init_tasks(std::vector<std::function<bool(std::string &)>> &tasks, int threads,
+                               std::function<void(int, const std::string &)> on_done)
+    {
+        int num = tasks.size();
+        std::vector<std::string> msgs(num);
+        std::vector<int> results(num, 0); // 0 未完成，1 成功，-1 失败
+        std::mutex lock;
+        std::condition_variable cond;
+        int next = 0;
+        bool b_abort = false;
+
+        auto worker = [&]()
+        {
+            while (true)
+            {
+                int i;
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    if (b_abort || next >= num)
+                    {
+                        return;
+                    }
+                    i = next++;
+                }
+                bool ok = tasks[i](msgs[i]);
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    results[i] = ok ? 1 : -1;
+                    b_abort = b_abort || !ok;
+                }
+                cond.notify_all();
+            }
+        };
 
-        char axmodel_path[1024];
-        for (int i = 0; i < attr.axmodel_num; i++)
+        std::vector<std::thread> workers;
+        for (int t = 0; threads > 1 && t < std::min(threads, num); t++)
         {
-            sprintf(axmodel_path, attr.template_filename_axmodel.c_str(), i);
-            llama_layers[i].filename = axmodel_path;
+            workers.emplace_back(worker);
+        }
+        if (workers.empty())
+        {
+            // 单线程时在当前线程中按顺序执行
+            worker();
+        }
+
+        bool ok = true;
+        for (int i = 0; i < num && ok; i++)
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            cond.wait(guard, [&]
+                      { return results[i] != 0 || (b_abort && i >= next); });
+            ok = results[i] == 1;
+            guard.unlock();
+            if (ok)
+            {
+                on_done(i, msgs[i]);
+            }
+        }
+        for (auto &t : workers)
+        {
+            t.join();
+        }
+        return ok;
+    }
+
+    // 非动态加载: 读文件、创建 handle 并解析 io
+    bool init_layer(int i, std::string &msg)
+    {
+        auto &layer = llama_layers[i];
+        int ret = layer.bundle_data ? layer.layer.init(layer.bundle_data, layer.bundle_size) : init_from_file(layer.layer, layer.filename);
+        if (ret != 0)
+        {
+            ALOGE("init axmodel(%s) failed", layer.filename.c_str());
+            return false;
+        }
+        if (!resolve_layer_io(i))
+        {
+            return false;
+        }
+        char buf[128];
+        sprintf(buf, "init %d axmodel ok,remain_cmm(%d MB)", i, get_remaining_cmm_size());
+        msg = buf;
+        return true;
+    }
+
+    // 动态加载: 只把模型文件读入内存(或 mmap)，handle 由加载线程创建
+    bool read_layer(int i, std::string &msg)
+    {
+        auto &layer = llama_layers[i];
+        if (_attr.b_compress_layer)
+        {
+            if (!read_compressed_layer(layer))
+            {
+                return false;
+            }
+        }
+        else if (layer.bundle_data)
+        {
+            // 已经在模型包的映射中
+        }
+        else if (!_attr.b_use_mmap_load_layer)
+        {
+            if (!read_model_file(layer.filename, layer.layer_buffer_vec))
+            {
+                ALOGE("read_file(%s) failed", layer.filename.c_str());
+                return false;
+            }
+        }
+        else if (!layer.layer_buffer.open_file(layer.filename.c_str(), mmap_option(MADV_SEQUENTIAL)))
+        {
+            ALOGE("mmap(%s) failed", layer.filename.c_str());
+            return false;
+        }
+        msg = "read_file " + layer.filename + " ok";
+        return true;
+    }
+
+    bool init_post(std::string &msg)
+    {
+        int ret = init_model(llama_post, _attr.filename_post_axmodel, "post");
+        if (ret != 0)
+        {
+            ALOGE("init post axmodel(%s) failed", _attr.filename_post_axmodel.c_str());
+            return false;
+        }
+        post_io.input = llama_post.find_input(0, "input");
+        post_io.output = llama_post.find_output(0, "output");
+        post_io.indices = llama_post.find_output(0, "indices");
+        if (!post_io.input || !post_io.output || (_attr.b_use_topk && !post_io.indices))
+        {
+            ALOGE("post axmodel(%s) io mismatch", _attr.filename_post_axmodel.c_str());
+            return false;
+        }
+        post_io.own_input = *post_io.input;
+        char buf[128];
+        sprintf(buf, "init post axmodel ok,remain_cmm(%d MB)", get_remaining_cmm_size());
+        msg = buf;
+        return true;
+    }
+
+    bool init_vpm(std::string &msg)
+    {
+        int ret;
+        bool b_vpm = !_attr.filename_vpm_resampler_axmodedl.empty();
+        if (b_vpm && _attr.b_vpm_two_stage)
+        {
+            ret = init_model(vpm_encoder, _attr.filename_vpm_encoder_axmodedl, "vpm_encoder");
+            if (ret != 0)
+            {
+                ALOGE("init vpm axmodel(%s) failed", _attr.filename_vpm_encoder_axmodedl.c_str());
+                return false;
+            }
+
+            ret = init_model(vpm_resampler, _attr.filename_vpm_resampler_axmodedl, "vpm_resampler");
+            if (ret != 0)
+            {
+                ALOGE("init vpm axmodel(%s) failed", _attr.filename_vpm_resampler_axmodedl.c_str());
+                return false;
+            }
+
+            _attr.vpm_height = vpm_encoder.get_input(0).vShape[1];
+            _attr.vpm_width = vpm_encoder.get_input(0).vShape[2];
+        }
+        else if (b_vpm)
+        {
+            ret = init_model(vpm_resampler, _attr.filename_vpm_resampler_axmodedl, "vpm_resampler");
+            if (ret != 0)
+            {
+                ALOGE("init vpm axmodel(%s) failed", _attr.filename_vpm_resampler_axmodedl.c_str());
+                return false;
+            }
+            _attr.vpm_height = vpm_resampler.get_input(0).vShape[1];
+            _attr.vpm_width = vpm_resampler.get_input(0).vShape[2];
+        }
+        vpm_ready = b_vpm;
+        char buf[128];
+        sprintf(buf, "init vpm axmodel ok,remain_cmm(%d MB)", get_remaining_cmm_size());
+        msg = buf;
+        return true;
+    }
+
+    // 读入模型文件(或模型包中的模型)并用 lz4 压缩保存，加载时再解压
+    bool read_compressed_layer(LLMLayer &layer)
+    {
+        std::vector<char> raw;
+        const char *src = layer.bundle_data;
+        size_t raw_size = layer.bundle_size;
+        int index = src ? -1 : loaded_file(layer.filename);
+        if (index >= 0)
+        {
+            src = file_loader.Wait(index, &raw_size);
+        }
+        else if (!src && read_file(layer.filename, raw))
+        {
+            src = raw.data();
+            raw_size = raw.size();
+        }
+        if (!src)
+        {
+            ALOGE("read_file(%s) failed", layer.filename.c_str());
+            if (index >= 0)
+            {
+                file_loader.Release(index);
+            }
+            return false;
+        }
+        layer.layer_buffer_vec.resize(lz4_compress_bound(raw_size));
+        size_t size = lz4_compress(src, raw_size, layer.layer_buffer_vec.data(), layer.layer_buffer_vec.size());
+        if (index >= 0)
+        {
+            file_loader.Release(index);
+        }
+        if (size == 0)
+        {
+            ALOGE("compress axmodel(%s) failed", layer.filename.c_str());
+            return false;
+        }
+        layer.layer_buffer_vec.resize(size);
+        layer.layer_buffer_vec.shrink_to_fit();
+        layer.raw_size = raw_size;
+        return true;
+    }
 
-            if (!attr.b_dynamic_load_axmodel_layer)
+    MMap::option_t mmap_option(int advice)
+    {
+        MMap::option_t opt;
+        opt.advice = advice;
+        opt.populate = _attr.b_mmap_populate;
+        opt.hugepage = _attr.b_mmap_hugepage;
+        return opt;
+    }
+
+    // 推理时还会从映射中读的部分: mmap 的 embed，以及动态加载且没有压缩的层
+    void warmup_mmap()
+    {
+        struct region_t
+        {
+            MMap *map;
+            size_t offset, size;
+        };
+        std::vector<region_t> regions;
+        bool b_layer = _attr.b_dynamic_load_axmodel_layer && !_attr.b_compress_layer;
+        if (bundle.is_open())
+        {
+            MMap *map = &bundle.mapping();
+            char *base = (char *)map->data();
+            size_t size;
+            char *embed = bundle.find("embed", &size);
+            if (_attr.b_use_mmap_load_embed && embed)
+            {
+                regions.push_back({map, (size_t)(embed - base), size});
+            }
+            for (int i = 0; b_layer && i < _attr.axmodel_num; i++)
             {
-                int ret = llama_layers[i].layer.init(llama_layers[i].filename.c_str(), false);
-                if (ret != 0)
+                regions.push_back({map, (size_t)(llama_layers[i].bundle_data - base), llama_layers[i].bundle_size});
+            }
+        }
+        else
+        {
+            if (embed_selector.GetMap())
+            {
+                regions.push_back({embed_selector.GetMap(), 0, embed_selector.GetMap()->size()});
+            }
+            for (int i = 0; b_layer && i < _attr.axmodel_num; i++)
+            {
+                if (llama_layers[i].layer_buffer.data())
                 {
-                    ALOGE("init axmodel(%s) failed", llama_layers[i].filename.c_str());
-                    return false;
+                    regions.push_back({&llama_layers[i].layer_buffer, 0, llama_layers[i].layer_buffer.size()});
                 }
-                int remain_cmm = get_remaining_cmm_size();
-                sprintf(axmodel_path, "init %d axmodel ok,remain_cmm(%d MB)", i, remain_cmm);
-                update_cqdm(&cqdm, i + 2, "count", axmodel_path);
             }
-            else
+        }
+
+        size_t total = 0, done = 0;
+        for (auto &r : regions)
+        {
+            total += r.size;
+        }
+        if (total == 0)
+        {
+            return;
+        }
+        int total_mb = std::max((int)(total >> 20), 1);
+        t_cqdm cqdm = create_cqdm(total_mb, 32);
+        timer t;
+        t.start();
+        for (auto &r : regions)
+        {
+            r.map->warmup([&](size_t n, size_t)
+                          {
+                              char buf[64];
+                              sprintf(buf, "warmup mmap %.1f MB", (done + n) / 1024.0 / 1024.0);
+                              update_cqdm(&cqdm, std::min((int)((done + n) >> 20), total_mb - 1), "MB", buf); },
+                          r.offset, r.size);
+            done += r.size;
+        }
+        printf("\n");
+        ALOGI("warmup mmap %.2f MB in %.2f ms", total / 1024.0 / 1024.0, t.cost());
+    }
+
+    // 后台读入 init 要用到的文件，顺序和使用的顺序一致: embed、各层、post、vpm(b_vpm 为 false 时不读)
+    void start_file_loader(const LLMAttrType &attr, bool b_vpm)
+    {
+        std::vector<std::string> files;
+        if (!attr.b_use_mmap_load_embed)
+        {
+            files.push_back(attr.filename_tokens_embed);
+        }
+        // 动态加载且 mmap 时层文件不需要读入
+        if (!attr.b_dynamic_load_axmodel_layer || attr.b_compress_layer || !attr.b_use_mmap_load_layer)
+        {
+            char axmodel_path[1024];
+            for (int i = 0; i < attr.axmodel_num; i++)
+            {
+                sprintf(axmodel_path, attr.template_filename_axmodel.c_str(), i);
+                files.push_back(axmodel_path);
+            }
+        }
+        files.push_back(attr.filename_post_axmodel);
+        if (b_vpm)
+        {
+            if (attr.b_vpm_two_stage)
+            {
+                files.push_back(attr.filename_vpm_encoder_axmodedl);
+            }
+            files.push_back(attr.filename_vpm_resampler_axmodedl);
+        }
+
+        file_loader_index.clear();
+        for (int i = 0; i < (int)files.size(); i++)
+        {
+            file_loader_index[files[i]] = i;
+        }
+        FileLoader::option_t opt;
+        opt.direct = attr.b_async_read_direct;
+        opt.max_buffered = (size_t)std::max(attr.async_read_buffer_mb, 0) << 20;
+        file_loader.Start(files, opt);
+    }
+
+    // 由 file_loader 读入的文件返回其序号，否则返回 -1
+    int loaded_file(const std::string &filename)
+    {
+        auto it = file_loader_index.find(filename);
+        return it == file_loader_index.end() ? -1 : it->second;
+    }
+
+    bool read_model_file(const std::string &filename, std::vector<char> &data)
+    {
+        int index = loaded_file(filename);
+        if (index < 0)
+        {
+            return read_file(filename, data);
+        }
+        size_t size;
+        char *buffer = file_loader.Wait(index, &size);
+        if (buffer)
+        {
+            data.assign(buffer, buffer + size);
+        }
+        file_loader.Release(index);
+        return buffer != nullptr;
+    }
+
+    // 用 file_loader 读好的 buffer init，不在其中时由 runner 自己读文件
+    int init_from_file(ax_runner_llm &runner, const std::string &filename)
+    {
+        int index = loaded_file(filename);
+        if (index < 0)
+        {
+            return runner.init(filename.c_str(), false);
+        }
+        size_t size;
+        char *data = file_loader.Wait(index, &size);
+        if (!data)
+        {
+            ALOGE("read_file(%s) failed", filename.c_str());
+            file_loader.Release(index);
+            return -1;
+        }
+        if (runner.get_model_name().empty())
+        {
+            runner.set_model_name(filename);
+        }
+        int ret = runner.init(data, size);
+        file_loader.Release(index);
+        return ret;
+    }
+
+    // 模型包中的模型直接从映射的内存 init
+    int init_model(ax_runner_llm &runner, const std::string &filename, const std::string &entry)
+    {
+        if (!bundle.is_open())
+        {
+            return init_from_file(runner, filename);
+        }
+        size_t size;
+        char *data = bundle.find(entry, &size);
+        if (!data)
+        {
+            ALOGE("%s not in bundle(%s)", entry.c_str(), bundle.path().c_str());
+            return -1;
+        }
+        runner.set_model_name(filename);
+        return runner.init(data, size);
+    }
+
+    // 打开模型包，meta 中有的字段覆盖 attr，模型路径改成 bundle:entry 的形式，只用于日志和 trace 中的模型名
+    bool open_bundle(LLMAttrType &attr)
+    {
+        MMap::option_t opt;
+        opt.populate = attr.b_mmap_populate;
+        opt.hugepage = attr.b_mmap_hugepage;
+        if (!bundle.open_file(attr.bundle_path, opt))
+        {
+            return false;
+        }
+        nlohmann::json meta = nlohmann::json::parse(bundle.meta(), nullptr, false);
+        if (!meta.is_object() || !meta.contains("axmodel_num"))
+        {
+            ALOGE("bundle(%s) meta invalid", attr.bundle_path.c_str());
+            return false;
+        }
+        try
+        {
+            attr.axmodel_num = meta["axmodel_num"];
+            if (meta.contains("tokens_embed_num"))
+                attr.tokens_embed_num = meta["tokens_embed_num"];
+            if (meta.contains("tokens_embed_size"))
+                attr.tokens_embed_size = meta["tokens_embed_size"];
+            if (meta.contains("img_token_id"))
+                attr.img_token_id = meta["img_token_id"];
+            if (meta.contains("tokenizer_type"))
+                attr.tokenizer_type = (TokenizerType)meta["tokenizer_type"].get<int>();
+            if (meta.contains("filename_tokenizer_model"))
+                attr.filename_tokenizer_model = meta["filename_tokenizer_model"];
+            if (meta.contains("b_bos"))
+                attr.b_bos = meta["b_bos"];
+            if (meta.contains("b_eos"))
+                attr.b_eos = meta["b_eos"];
+            if (meta.contains("b_vpm_two_stage"))
+                attr.b_vpm_two_stage = meta["b_vpm_two_stage"];
+        }
+        catch (const nlohmann::json::exception &e)
+        {
+            ALOGE("bundle(%s) meta invalid: %s", attr.bundle_path.c_str(), e.what());
+            return false;
+        }
+
+        const std::string &path = attr.bundle_path;
+        attr.template_filename_axmodel = path + ":layer.%d";
+        attr.filename_post_axmodel = path + ":post";
+        attr.filename_tokens_embed = path + ":embed";
+        attr.filename_vpm_encoder_axmodedl = path + ":vpm_encoder";
+        // 没有 vpm_resampler 时和没指定文件一样按纯文本模型处理
+        attr.filename_vpm_resampler_axmodedl = bundle.has("vpm_resampler") ? path + ":vpm_resampler" : "";
+
+        // 模型顺序读一遍，embed 按 token 随机读
+        auto &map = bundle.mapping();
+        map.advise(MADV_SEQUENTIAL);
+        size_t size;
+        char *embed = bundle.find("embed", &size);
+        if (embed)
+        {
+            map.advise(MADV_RANDOM, embed - (char *)map.data(), size);
+        }
+        return true;
+    }
+
+    // 缓存文件的 key: 第 0 层和 vpm 模型(或模型包)的路径、大小和修改时间，有文件不存在时返回 null
+    static nlohmann::json meta_cache_key(const LLMAttrType &attr)
+    {
+        std::vector<std::string> files;
+        if (!attr.bundle_path.empty())
+        {
+            files.push_back(attr.bundle_path);
+        }
+        else
+        {
+            char axmodel_path[1024];
+            sprintf(axmodel_path, attr.template_filename_axmodel.c_str(), 0);
+            files.push_back(axmodel_path);
+            if (!attr.filename_vpm_resampler_axmodedl.empty())
+            {
+                if (attr.b_vpm_two_stage)
+                {
+                    files.push_back(attr.filename_vpm_encoder_axmodedl);
+                }
+                files.push_back(attr.filename_vpm_resampler_axmodedl);
+            }
+        }
+        nlohmann::json key = nlohmann::json::array();
+        for (auto &file : files)
+        {
+            struct stat st;
+            if (stat(file.c_str(), &st) != 0)
+            {
+                return nullptr;
+            }
+            key.push_back({{"path", file},
+                           {"size", (unsigned long long)st.st_size},
+                           {"mtime_ns", (unsigned long long)st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec}});
+        }
+        return key;
+    }
+
+    static std::string meta_cache_file(const LLMAttrType &attr)
+    {
+        if (attr.meta_cache_path != "auto")
+        {
+            return attr.meta_cache_path;
+        }
+        if (!attr.bundle_path.empty())
+        {
+            return attr.bundle_path + ".meta.json";
+        }
+        char axmodel_path[1024];
+        sprintf(axmodel_path, attr.template_filename_axmodel.c_str(), 0);
+        return std::string(axmodel_path) + ".meta.json";
+    }
+
+    // 读出缓存的参数，文件不存在、格式不对或者 key 和当前的模型文件不一致时返回 false
+    static bool load_meta_cache(const std::string &path, const nlohmann::json &key, nlohmann::json &meta)
+    {
+        std::vector<char> data;
+        if (key.is_null() || !read_file(path, data))
+        {
+            return false;
+        }
+        meta = nlohmann::json::parse(data.begin(), data.end(), nullptr, false);
+        if (!meta.is_object() || meta["version"] != 1 || !meta.contains("files") || meta["files"] != key)
+        {
+            ALOGI("meta cache(%s) outdated", path.c_str());
+            return false;
+        }
+        for (auto name : {"axmodel_num", "max_token_len", "kv_cache_size", "kv_cache_num", "prefill_token_num"})
+        {
+            if (!meta.contains(name) || !meta[name].is_number_integer())
+            {
+                ALOGW("meta cache(%s) invalid", path.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 先写临时文件再 rename，模型目录只读时只打印警告
+    static void save_meta_cache(const std::string &path, const nlohmann::json &meta)
+    {
+        std::string tmp = path + ".tmp";
+        std::string data = meta.dump(4) + "\n";
+        FILE *fp = fopen(tmp.c_str(), "w");
+        bool ok = fp && fwrite(data.data(), 1, data.size(), fp) == data.size();
+        ok = fp && fclose(fp) == 0 && ok;
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+        {
+            ALOGW("save meta cache(%s) failed", path.c_str());
+            remove(tmp.c_str());
+            return;
+        }
+        ALOGI("save meta cache(%s)", path.c_str());
+    }
+
+    // 动态加载: 从读入的文件创建第 m 层的 handle，io 在第一次加载时解析
+    bool load_layer(int m)
+    {
+        auto &layer = llama_layers[m];
+        int ret;
+        if (layer.raw_size)
+        {
+            if (layer_scratch.size() < layer.raw_size)
+            {
+                layer_scratch.resize(layer.raw_size);
+            }
+            if (lz4_decompress(layer.layer_buffer_vec.data(), layer.layer_buffer_vec.size(), layer_scratch.data(), layer.raw_size) != 0)
+            {
+                ALOGE("decompress axmodel(%s) failed", layer.filename.c_str());
+                return false;
+            }
+            ret = layer.layer.init(layer_scratch.data(), layer.raw_size);
+        }
+        else if (layer.bundle_data)
+        {
+            ret = layer.layer.init(layer.bundle_data, layer.bundle_size);
+        }
+        else if (_attr.b_use_mmap_load_layer)
+        {
+            ret = layer.layer.init((char *)layer.layer_buffer.data(), layer.layer_buffer.size());
+        }
+        else
+        {
+            ret = layer.layer.init(layer.layer_buffer_vec.data(), layer.layer_buffer_vec.size());
+        }
+        if (ret != 0 || !resolve_layer_io(m))
+        {
+            ALOGE("init axmodel(%s) failed", layer.filename.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // 动态加载时 io 在第一次 init 之后才存在
+    bool resolve_layer_io(int m)
+    {
+        if (layer_io_ready[m])
+        {
+            return true;
+        }
+        auto &layer = llama_layers[m].layer;
+        if (m == 0)
+        {
+            // group 的数量和 shape 由第 0 层确定，其它层必须一致
+            prefill_groups.clear();
+            for (int grpid = 1; grpid < layer.get_num_groups(); grpid++)
+            {
+                LLMPrefillGroup g;
+                g.grpid = grpid;
+                g.io.assign(_attr.axmodel_num, LLMLayerIO());
+                prefill_groups.push_back(g);
+            }
+        }
+        if (prefill_groups.empty() || layer.get_num_groups() != (int)prefill_groups.size() + 1)
+        {
+            ALOGE("axmodel(%s) has %d groups, expect %d", llama_layers[m].filename.c_str(), layer.get_num_groups(), (int)prefill_groups.size() + 1);
+            return false;
+        }
+        resolve_group_io(layer, decode_grpid, decode_io[m]);
+        auto &d = decode_io[m];
+        if (!d.indices || !d.mask || !d.input || !d.k_cache || !d.v_cache || !d.k_cache_out || !d.v_cache_out || !d.output)
+        {
+            ALOGE("axmodel(%s) io mismatch", llama_layers[m].filename.c_str());
+            return false;
+        }
+        // 一行(一个 token)的 kv 需要满足 npu 地址对齐，否则仍然走拷贝
+        d.kv_view = d.k_cache_out->nSize % AX_RUNNER_IO_ALIGN_SIZE == 0 && d.v_cache_out->nSize % AX_RUNNER_IO_ALIGN_SIZE == 0 &&
+                    d.k_cache->phyAddr % AX_RUNNER_IO_ALIGN_SIZE == 0 && d.v_cache->phyAddr % AX_RUNNER_IO_ALIGN_SIZE == 0;
+        for (auto &g : prefill_groups)
+        {
+            resolve_group_io(layer, g.grpid, g.io[m]);
+            auto &p = g.io[m];
+            if (!p.indices || !p.mask || !p.input || !p.k_cache_out || !p.v_cache_out || !p.output || !p.k_cache != !p.v_cache)
+            {
+                ALOGE("axmodel(%s) group %d io mismatch", llama_layers[m].filename.c_str(), g.grpid);
+                return false;
+            }
+            if (m == 0)
+            {
+                g.token_num = p.indices->vShape[1];
+                g.history = p.k_cache ? p.k_cache->vShape[1] : 0;
+            }
+            d.kv_view = d.kv_view && p.k_cache_out->nSize <= d.k_cache->nSize && p.v_cache_out->nSize <= d.v_cache->nSize;
+        }
+        if (d.kv_view)
+        {
+            // io 在动态加载的 deinit/init 之间保留；带 history 的 group 在每次 prefill 前按写入的位置重新绑定
+            for (auto &g : prefill_groups)
+            {
+                auto &p = g.io[m];
+                if (layer.set_output_buffer(g.grpid, p.k_cache_out->nIdx, *d.k_cache) != 0 ||
+                    layer.set_output_buffer(g.grpid, p.v_cache_out->nIdx, *d.v_cache) != 0)
+                {
+                    ALOGE("axmodel(%s) bind kv cache failed", llama_layers[m].filename.c_str());
+                    return false;
+                }
+            }
+        }
+        else if (m == 0)
+        {
+            ALOGW("kv cache row size %d not aligned to %d, use copy", d.k_cache_out->nSize, AX_RUNNER_IO_ALIGN_SIZE);
+        }
+
+        // 第 0 层总是先于其它层解析
+        bool b_bind = m == 0 || (bind_activation(layer, decode_grpid, m, d, decode_plan) && bind_control(layer, decode_grpid, d, decode_plan));
+        for (auto &g : prefill_groups)
+        {
+            b_bind = b_bind && (m == 0 || (bind_activation(layer, g.grpid, m, g.io[m], g.plan) && bind_control(layer, g.grpid, g.io[m], g.plan)));
+        }
+        if (!b_bind)
+        {
+            ALOGE("axmodel(%s) bind activation/mask/indices failed", llama_layers[m].filename.c_str());
+            return false;
+        }
+        // shared 的 io 必须已经绑定，decode 的 K_cache_out/V_cache_out 在推理前绑定
+        std::vector<const ax_runner_tensor_t *> tensors = {d.indices, d.mask, d.input, d.k_cache, d.v_cache, d.output};
+        for (auto &g : prefill_groups)
+        {
+            auto &p = g.io[m];
+            tensors.insert(tensors.end(), {p.indices, p.mask, p.input, p.k_cache, p.v_cache, p.k_cache_out, p.v_cache_out, p.output});
+        }
+        for (auto t : tensors)
+        {
+            if (t && t->nSize > 0 && !t->pVirAddr)
+            {
+                ALOGE("axmodel(%s) io %s is shared but not bound", llama_layers[m].filename.c_str(), t->sName.c_str());
+                return false;
+            }
+        }
+        if (!d.kv_view && (!d.k_cache_out->pVirAddr || !d.v_cache_out->pVirAddr))
+        {
+            ALOGE("axmodel(%s) K_cache_out/V_cache_out is shared but kv cache can not be bound", llama_layers[m].filename.c_str());
+            return false;
+        }
+        layer_io_ready[m] = 1;
+        return true;
+    }
+
+    // mask 中关闭的位置的值
+    static unsigned short mask_closed()
+    {
+        return bfloat16(-65536.f).data;
+    }
+
+    // prefill mask 每行 history + token_num 列: 前 history 列对应 kv cache 中已有的位置，只打开前 pos 个；后面是新 token 之间的 causal mask
+    void write_prefill_mask(const LLMPrefillGroup &g, int pos)
+    {
+        unsigned short closed = mask_closed();
+        int width = g.history + g.token_num;
+        unsigned short *mask_p = (unsigned short *)g.io[0].mask->pVirAddr;
+        for (int i = 0; i < g.token_num; i++)
+        {
+            unsigned short *row = mask_p + i * width;
+            for (int j = 0; j < g.history; j++)
+            {
+                row[j] = j < pos ? 0 : closed;
+            }
+            for (int j = 0; j < g.token_num; j++)
+            {
+                row[g.history + j] = j <= i ? 0 : closed;
+            }
+        }
+        llama_layers[0].layer.cache_flush(*g.io[0].mask);
+    }
+
+    static void update_cost(double &ema, double ms)
+    {
+        ema = ema < 0 ? ms : ema * 0.7 + ms * 0.3;
+    }
+
+    // 一次 prefill 的预估耗时: 测到过的用滑动平均；没测到的按 token_num 从最接近的已测 group 折算
+    // 都没测到时按 decode 一步的耗时乘 token_num，decode 也没测到时就用 token_num
+    double estimate_prefill_cost(const LLMPrefillGroup &g)
+    {
+        if (g.cost_ms >= 0)
+        {
+            return g.cost_ms;
+        }
+        const LLMPrefillGroup *ref = nullptr;
+        for (auto &h : prefill_groups)
+        {
+            if (h.cost_ms >= 0 && (!ref || std::abs(h.token_num - g.token_num) < std::abs(ref->token_num - g.token_num)))
+            {
+                ref = &h;
+            }
+        }
+        if (ref)
+        {
+            return ref->cost_ms * g.token_num / ref->token_num;
+        }
+        return decode_cost_ms >= 0 ? decode_cost_ms * g.token_num : g.token_num;
+    }
+
+    // 把从 kv cache 的 pos 开始的 total 个 token 切成若干段，每段 (group 下标, token 数)，group 下标为 -1 表示用 decode group 逐个送入，放不下时返回 false
+    // 每段的 group: history 要覆盖已有的 pos 行(pos 为 0 时不带 history 的 group 也可以)，kv 直接写入 kv cache 时整个 token_num 行都不能超出
+    // 按预估耗时选总耗时最小的分法，相同时段数少的优先；decode 总是可用，能不能放下只取决于模型和 token 数
+    bool plan_prefill_chunks(int pos, int total, std::vector<std::pair<int, int>> &chunks, double *cost = nullptr)
+    {
+        chunks.clear();
+        if (total <= 0 || pos + total >= _attr.max_token_len)
+        {
+            return false;
+        }
+        std::vector<double> group_cost;
+        for (auto &g : prefill_groups)
+        {
+            group_cost.push_back(estimate_prefill_cost(g));
+        }
+        // decode 一步还没测到时按 token_num 最小的 group 一次 prefill 的预估耗时，能用 prefill 的地方仍然先用 prefill
+        double step_cost = decode_cost_ms;
+        if (step_cost < 0)
+        {
+            int ref = -1;
+            for (int i = 0; i < (int)prefill_groups.size(); i++)
+            {
+                if (ref < 0 || prefill_groups[i].token_num < prefill_groups[ref].token_num)
+                {
+                    ref = i;
+                }
+            }
+            step_cost = ref < 0 ? 1 : group_cost[ref];
+        }
+
+        // best[i]: 处理完前 i 个 token 的最小耗时和段数，from[i] 为最后一段
+        std::vector<std::pair<double, int>> best(total + 1, {-1, 0});
+        std::vector<std::pair<int, int>> from(total + 1);
+        best[0] = {0, 0};
+        auto relax = [&](int done, int grp, int n, double c)
+        {
+            std::pair<double, int> v = {best[done].first + c, best[done].second + 1};
+            if (best[done + n].first < 0 || v < best[done + n])
+            {
+                best[done + n] = v;
+                from[done + n] = {grp, n};
+            }
+        };
+        for (int done = 0; done < total; done++)
+        {
+            if (best[done].first < 0)
+            {
+                continue;
+            }
+            int p = pos + done;
+            for (int i = 0; i < (int)prefill_groups.size(); i++)
+            {
+                auto &g = prefill_groups[i];
+                int n = std::min(total - done, g.token_num);
+                int rows = decode_io[0].kv_view ? g.token_num : n;
+                if ((p > 0 && g.history < p) || p + rows > _attr.kv_cache_num)
+                {
+                    continue;
+                }
+                relax(done, i, n, group_cost[i]);
+            }
+            relax(done, -1, 1, step_cost);
+        }
+        if (best[total].first < 0)
+        {
+            return false;
+        }
+        for (int i = total; i > 0; i -= from[i].second)
+        {
+            // 连续的 decode 合成一段
+            if (from[i].first < 0 && chunks.size() && chunks.back().first < 0)
+            {
+                chunks.back().second++;
+            }
+            else
+            {
+                chunks.push_back(from[i]);
+            }
+        }
+        std::reverse(chunks.begin(), chunks.end());
+        if (cost)
+        {
+            *cost = best[total].first;
+        }
+        return true;
+    }
+
+    // 有会话时按接在会话之后编码(tokenizer 不加 bos 和 system prompt)；和 Run 一样先检查能不能接上，放不下时开始新的会话重新编码
+    std::vector<int> encode_prompt(const std::string &prompt, bool b_img_prompt)
+    {
+        if (kv_pos > 0)
+        {
+            std::vector<int> input_ids = tokenizer->Encode(prompt, b_img_prompt, true);
+            std::vector<std::pair<int, int>> chunks;
+            int num = input_ids.size() + (pending_token >= 0 ? 1 : 0);
+            if (plan_prefill_chunks(kv_pos, num, chunks))
+            {
+                return input_ids;
+            }
+            ALOGW("%d tokens do not fit after %d tokens of the session, start a new session", num, kv_pos);
+            Reset();
+        }
+        return tokenizer->Encode(prompt, b_img_prompt, false);
+    }
+
+    // 每个 token 的 key 为它的 embed 的 hash，图片的 embed 也一样处理
+    std::vector<uint64_t> prefix_keys(const std::vector<unsigned short> &embed, int num)
+    {
+        std::vector<uint64_t> keys(num);
+        for (int i = 0; i < num; i++)
+        {
+            keys[i] = PrefixCache::Hash(embed.data() + (size_t)i * _attr.tokens_embed_size, _attr.tokens_embed_size * sizeof(unsigned short));
+        }
+        return keys;
+    }
+
+    // 新会话开始时查找输入的前缀，命中时把各层的 kv 行拷回 kv cache，返回恢复的 token 数，chunks 改为剩下部分的分段
+    // 至少留一个 token 给 prefill 产生 post 的输入；剩下的部分放不下时不使用缓存
+    int restore_prefix(const std::vector<uint64_t> &keys, int num, std::vector<std::pair<int, int>> &chunks, double &plan_cost)
+    {
+        std::vector<const char *> rows;
+        int len = prefix_cache.Match(keys, num - 1, rows);
+        std::vector<std::pair<int, int>> rest;
+        double rest_cost = 0;
+        if (len == 0 || !plan_prefill_chunks(len, num - len, rest, &rest_cost))
+        {
+            return 0;
+        }
+
+        // 拷贝和 flush 期间加载线程不能 init/deinit 这些层
+        bool b_restored = false;
+        size_t row_bytes = sizeof(unsigned short) * _attr.kv_cache_size;
+        with_layer_io([&]()
+                      {
+            if (!all_layer_io_ready())
+            {
+                return;
+            }
+            for (int m = 0; m < _attr.axmodel_num; m++)
+            {
+                auto &io = decode_io[m];
+                auto &layer = llama_layers[m].layer;
+                for (int i = 0; i < len; i++)
+                {
+                    const char *row = rows[i] + 2 * m * row_bytes;
+                    memcpy((char *)io.k_cache->pVirAddr + i * row_bytes, row, row_bytes);
+                    memcpy((char *)io.v_cache->pVirAddr + i * row_bytes, row + row_bytes, row_bytes);
+                }
+                layer.cache_flush(*io.k_cache, 0, len * row_bytes);
+                layer.cache_flush(*io.v_cache, 0, len * row_bytes);
+            }
+            b_restored = true; });
+        if (!b_restored)
+        {
+            return 0;
+        }
+        open_decode_mask(0, len);
+        chunks = rest;
+        plan_cost = rest_cost;
+        return len;
+    }
+
+    // 保存新会话输入的前 num 个位置的 kv，已经缓存的位置不再拷贝
+    void save_prefix(const std::vector<uint64_t> &keys, int num)
+    {
+        size_t row_bytes = sizeof(unsigned short) * _attr.kv_cache_size;
+        with_layer_io([&]()
+                      {
+            if (!all_layer_io_ready())
+            {
+                return;
+            }
+            for (int m = 0; m < _attr.axmodel_num; m++)
+            {
+                llama_layers[m].layer.cache_invalidate(*decode_io[m].k_cache, 0, num * row_bytes);
+                llama_layers[m].layer.cache_invalidate(*decode_io[m].v_cache, 0, num * row_bytes);
+            }
+            prefix_cache.Insert(keys, num, [&](int i, char *dst)
+                                {
+                for (int m = 0; m < _attr.axmodel_num; m++)
+                {
+                    memcpy(dst + 2 * m * row_bytes, (char *)decode_io[m].k_cache->pVirAddr + i * row_bytes, row_bytes);
+                    memcpy(dst + (2 * m + 1) * row_bytes, (char *)decode_io[m].v_cache->pVirAddr + i * row_bytes, row_bytes);
+                } }); });
+    }
+
+    // 在主线程访问各层的 io: 动态加载时 io 由加载线程在层第一次加载时解析，之后还会反复 init/deinit 同一个 runner
+    // 加载线程运行时暂停它并在它的锁内执行 fn，layer_io_ready 和各层的 io 只在 fn 中读取
+    void with_layer_io(const std::function<void()> &fn)
+    {
+        if (layer_loader.IsRunning())
+        {
+            layer_loader.Exclusive(fn);
+        }
+        else
+        {
+            fn();
+        }
+    }
+
+    // 只在 with_layer_io 中调用
+    bool all_layer_io_ready()
+    {
+        return std::all_of(layer_io_ready.begin(), layer_io_ready.end(), [](char r)
+                           { return r != 0; });
+    }
+
+    // 动态加载时各层的 io(包括 kv cache)在第一次加载之后才存在，还没加载过的层先加载一次
+    bool ensure_layer_io()
+    {
+        std::vector<char> ready;
+        with_layer_io([&]()
+                      { ready = layer_io_ready; });
+        for (int m = 0; m < _attr.axmodel_num; m++)
+        {
+            if (ready[m])
+            {
+                continue;
+            }
+            if (!_attr.b_dynamic_load_axmodel_layer || !layer_loader.Acquire(m))
+            {
+                ALOGE("load axmodel(%s) failed", llama_layers[m].filename.c_str());
+                if (_attr.b_dynamic_load_axmodel_layer)
+                {
+                    layer_loader.Release(m);
+                }
+                return false;
+            }
+            layer_loader.Release(m);
+        }
+        return true;
+    }
+
+    // 把 decode group 的输入输出指向第 indices 个 token
+    // K_cache_out/V_cache_out 重新绑定失败时返回 false，这时 npu 会把新的 kv 写到上一次绑定的行
+    bool bind_decode_io(int m, unsigned int indices)
+    {
+        auto &io = decode_io[m];
+        if (m == 0)
+        {
+            memcpy(io.indices->pVirAddr, &indices, sizeof(indices));
+            llama_layers[0].layer.cache_flush(*io.indices);
+        }
+        if (io.kv_view)
+        {
+            // 本次推理时 mask[indices] 仍是屏蔽的，npu 读 K_cache 时不会用到正在写的这一行
+            unsigned long offset = (unsigned long)indices * io.k_cache_out->nSize;
+            auto &layer = llama_layers[m].layer;
+            if (layer.set_output_buffer(decode_grpid, io.k_cache_out->nIdx, *io.k_cache, offset) != 0 ||
+                layer.set_output_buffer(decode_grpid, io.v_cache_out->nIdx, *io.v_cache, offset) != 0)
+            {
+                ALOGE("axmodel(%s) bind kv cache row %u failed", llama_layers[m].filename.c_str(), indices);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // decode 的一个 token 经过所有层后把新的 kv 放到第 indices 行，被 Stop 打断或者出错时返回 false
+    bool decode_layers(unsigned int indices, const unsigned short *embed, std::function<void()> on_submit_first = nullptr)
+    {
+        auto fail = [&](int m)
+        {
+            if (_attr.b_dynamic_load_axmodel_layer)
+            {
+                layer_loader.Release(m);
+            }
+            return false;
+        };
+        for (int m = 0; m < _attr.axmodel_num; m++)
+        {
+            if (b_stop)
+            {
+                return false;
+            }
+
+            auto &layer = llama_layers[m];
+
+            if (_attr.b_dynamic_load_axmodel_layer && !layer_loader.Acquire(m))
+            {
+                // 第一次加载失败时 io 还没有解析，之后失败时 handle 已经销毁，都不能推理
+                ALOGE("load axmodel(%s) failed", layer.filename.c_str());
+                layer_loader.Release(m);
+                return false;
+            }
+
+            auto &io = decode_io[m];
+            unsigned short *input_k_cache_ptr = (unsigned short *)io.k_cache->pVirAddr;
+            unsigned short *input_v_cache_ptr = (unsigned short *)io.v_cache->pVirAddr;
+
+            if ((m == 0 || _attr.b_dynamic_load_axmodel_layer) && !bind_decode_io(m, indices))
+            {
+                return fail(m);
+            }
+
+            if (m == 0)
+            {
+                memcpy(io.input->pVirAddr, embed, _attr.tokens_embed_size * sizeof(unsigned short));
+                layer.layer.cache_flush(*io.input);
+            }
+
+            layer.layer.submit(decode_grpid);
+            bool b_next_bound = m + 1 >= _attr.axmodel_num || _attr.b_dynamic_load_axmodel_layer || bind_decode_io(m + 1, indices);
+            if (m == 0 && on_submit_first)
+            {
+                on_submit_first();
+            }
+            layer.layer.wait();
+            if (!b_next_bound)
+            {
+                return fail(m);
+            }
+
+            if (!io.kv_view)
+            {
+                size_t kv_bytes = sizeof(unsigned short) * _attr.kv_cache_size;
+                layer.layer.cache_invalidate(*io.k_cache_out);
+                memcpy(input_k_cache_ptr + indices * _attr.kv_cache_size, io.k_cache_out->pVirAddr, kv_bytes);
+                layer.layer.cache_flush(*io.k_cache, indices * kv_bytes, kv_bytes);
+
+                layer.layer.cache_invalidate(*io.v_cache_out);
+                memcpy(input_v_cache_ptr + indices * _attr.kv_cache_size, io.v_cache_out->pVirAddr, kv_bytes);
+                layer.layer.cache_flush(*io.v_cache, indices * kv_bytes, kv_bytes);
+            }
+
+            if (_attr.b_dynamic_load_axmodel_layer)
+            {
+                layer_loader.Release(m);
+            }
+        }
+        return !b_stop;
+    }
+
+    // 打开 decode mask 中第 pos 开始的 n 个位置
+    // 新会话开始时关闭 decode mask 中 kv cache 的所有位置，最后一个位置对应当前 token，总是打开
+    void close_decode_mask()
+    {
+        unsigned short *mask = (unsigned short *)decode_io[0].mask->pVirAddr;
+        std::fill(mask, mask + _attr.kv_cache_num, mask_closed());
+        mask[_attr.kv_cache_num] = 0;
+        llama_layers[0].layer.cache_flush(*decode_io[0].mask);
+    }
+
+    void open_decode_mask(int pos, int n)
+    {
+        unsigned short *mask = (unsigned short *)decode_io[0].mask->pVirAddr;
+        for (int i = pos; i < pos + n; i++)
+        {
+            mask[i] = 0;
+        }
+        llama_layers[0].layer.cache_flush(*decode_io[0].mask, pos * sizeof(unsigned short), n * sizeof(unsigned short));
+    }
+
+    // 输入中很短的一段用 decode group 逐个送入，每个 token 之后打开它在 mask 中的位置
+    bool decode_chunk(int pos, const unsigned short *embed, int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            timer t;
+            t.start();
+            if (!decode_layers(pos + i, embed + (size_t)i * _attr.tokens_embed_size))
+            {
+                return false;
+            }
+            update_cost(decode_cost_ms, t.cost());
+            open_decode_mask(pos + i, 1);
+        }
+        return true;
+    }
+
+    // 在 kv cache 的 pos 之后 prefill n 个 token，embed 为这 n 个 token 的输入，被 Stop 打断或者出错时返回 false
+    bool prefill_chunk(LLMPrefillGroup &group, int pos, const unsigned short *embed, int n)
+    {
+        auto &layer0 = llama_layers[0].layer;
+        if (group.history > 0)
+        {
+            write_prefill_mask(group, pos);
+        }
+        unsigned int *input_indices_ptr = (unsigned int *)group.io[0].indices->pVirAddr;
+        for (int i = 0; i < n; i++)
+        {
+            input_indices_ptr[i] = pos + i;
+        }
+        layer0.cache_flush(*group.io[0].indices, 0, n * sizeof(unsigned int));
+
+        size_t embed_bytes = (size_t)n * _attr.tokens_embed_size * sizeof(unsigned short);
+        for (int m = 0; m < _attr.axmodel_num; m++)
+        {
+            if (b_stop)
+            {
+                return false;
+            }
+
+            auto &layer = llama_layers[m];
+
+            if (_attr.b_dynamic_load_axmodel_layer && !layer_loader.Acquire(m))
+            {
+                // 第一次加载失败时 io 还没有解析，之后失败时 handle 已经销毁，都不能推理
+                ALOGE("load axmodel(%s) failed", layer.filename.c_str());
+                layer_loader.Release(m);
+                return false;
+            }
+
+            auto &io = group.io[m];
+            auto &dio = decode_io[m];
+            if (m == 0)
+            {
+                memcpy(io.input->pVirAddr, embed, embed_bytes);
+                layer.layer.cache_flush(*io.input, 0, embed_bytes);
+            }
+            if (dio.kv_view && group.history > 0)
+            {
+                // 新的 kv 直接写到 kv cache 的第 pos 行之后
+                // 绑定失败时 npu 会写到上一次绑定的位置，覆盖会话中已有的行
+                unsigned long offset = (unsigned long)pos * dio.k_cache_out->nSize;
+                if (layer.layer.set_output_buffer(group.grpid, io.k_cache_out->nIdx, *dio.k_cache, offset) != 0 ||
+                    layer.layer.set_output_buffer(group.grpid, io.v_cache_out->nIdx, *dio.v_cache, offset) != 0)
+                {
+                    ALOGE("axmodel(%s) bind kv cache row %d failed", layer.filename.c_str(), pos);
+                    if (_attr.b_dynamic_load_axmodel_layer)
+                    {
+                        layer_loader.Release(m);
+                    }
+                    return false;
+                }
+            }
+
+            layer.layer.submit(group.grpid);
+            layer.layer.wait();
+
+            if (!dio.kv_view)
+            {
+                // 只有前 n 行有效，后面的行在 decode 时被 mask 屏蔽
+                size_t row_bytes = sizeof(unsigned short) * _attr.kv_cache_size;
+                size_t kv_bytes = row_bytes * n;
+                layer.layer.cache_invalidate(*io.k_cache_out, 0, kv_bytes);
+                memcpy((char *)dio.k_cache->pVirAddr + pos * row_bytes, io.k_cache_out->pVirAddr, kv_bytes);
+                layer.layer.cache_flush(*dio.k_cache, pos * row_bytes, kv_bytes);
+
+                layer.layer.cache_invalidate(*io.v_cache_out, 0, kv_bytes);
+                memcpy((char *)dio.v_cache->pVirAddr + pos * row_bytes, io.v_cache_out->pVirAddr, kv_bytes);
+                layer.layer.cache_flush(*dio.v_cache, pos * row_bytes, kv_bytes);
+            }
+
+            if (_attr.b_dynamic_load_axmodel_layer)
+            {
+                layer_loader.Release(m);
+            }
+        }
+        return true;
+    }
+
+    static bool parse_alloc_policy(const std::string &str, std::map<std::string, ax_runner_alloc_policy_e> &layer_policy,
+                                   std::map<std::string, ax_runner_alloc_policy_e> &post_policy)
+    {
+        const std::map<std::string, ax_runner_alloc_policy_e> names = {
+            {"default", AX_RUNNER_ALLOC_DEFAULT},
+            {"cached", AX_RUNNER_ALLOC_CACHED},
+            {"uncached", AX_RUNNER_ALLOC_UNCACHED},
+            {"shared", AX_RUNNER_ALLOC_SHARED},
+        };
+        std::stringstream ss(str);
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            if (item.empty())
+            {
+                continue;
+            }
+            auto pos = item.find('=');
+            auto it = pos == std::string::npos ? names.end() : names.find(item.substr(pos + 1));
+            if (it == names.end())
+            {
+                ALOGE("invalid io alloc policy: %s", item.c_str());
+                return false;
+            }
+            std::string name = item.substr(0, pos);
+            if (name.compare(0, 5, "post.") == 0)
+            {
+                if (it->second == AX_RUNNER_ALLOC_SHARED)
+                {
+                    ALOGE("post io can not be shared: %s", item.c_str());
+                    return false;
+                }
+                post_policy[name.substr(5)] = it->second;
+            }
+            else
+            {
+                layer_policy[name] = it->second;
+            }
+        }
+        return true;
+    }
+
+    void reset_cache_stats()
+    {
+        for (auto &layer : llama_layers)
+        {
+            layer.layer.reset_cache_stats();
+        }
+        llama_post.reset_cache_stats();
+    }
+
+    // 汇总所有层和 post 的 cache 维护统计(同名 tensor 累加)，steps 为推理的步数，按每步平均
+    void report_cache_stats(const char *stage, int steps)
+    {
+        if (!_attr.b_cache_stats)
+        {
+            reset_cache_stats();
+            return;
+        }
+        std::map<std::string, ax_runner_cache_stat_t> total;
+        auto merge = [&](ax_runner_llm &runner)
+        {
+            for (auto &it : runner.get_cache_stats())
+            {
+                auto &stat = total[it.first];
+                stat.invalidate_count += it.second.invalidate_count;
+                stat.invalidate_bytes += it.second.invalidate_bytes;
+                stat.flush_count += it.second.flush_count;
+                stat.flush_bytes += it.second.flush_bytes;
+            }
+        };
+        for (auto &layer : llama_layers)
+        {
+            merge(layer.layer);
+        }
+        merge(llama_post);
+        reset_cache_stats();
+
+        steps = std::max(steps, 1);
+        unsigned long long sum = 0;
+        for (auto &it : total)
+        {
+            auto &stat = it.second;
+            sum += stat.invalidate_bytes + stat.flush_bytes;
+            ALOGI("%s cache %-12s invalidate %8.2f KB/step (%.1f calls), flush %8.2f KB/step (%.1f calls)", stage, it.first.c_str(),
+                  stat.invalidate_bytes / 1024.0 / steps, (float)stat.invalidate_count / steps,
+                  stat.flush_bytes / 1024.0 / steps, (float)stat.flush_count / steps);
+        }
+        ALOGI("%s cache total %.2f KB/step, %d steps", stage, sum / 1024.0 / steps, steps);
+    }
+
+    LLMPostprocess postprocess;
+    static int post_process(LLMPostprocess &postprocess, unsigned short *p, int n, std::vector<int> &history, float *val = 0)
+    {
+        std::vector<float> logits(n);
+        for (int i = 0; i < n; i++)
+        {
+            unsigned int proc = p[i] << 16;
+            logits[i] = *reinterpret_cast<float *>(&proc);
+            }
+
+        return postprocess.apply(logits, history);
+
+    }
+
+public:
+    bool Init(LLMAttrType attr)
+    {
+        ALOGI("LLM init start");
+        if (!attr.bundle_path.empty() && !open_bundle(attr))
+        {
+            return false;
+        }
+        t_cqdm cqdm = create_cqdm(attr.axmodel_num + 4, 32);
+        this->_attr = attr;
+
+        std::string meta_path = attr.meta_cache_path.empty() ? "" : meta_cache_file(attr);
+        nlohmann::json meta_key = meta_path.empty() ? nlohmann::json() : meta_cache_key(attr);
+        nlohmann::json meta;
+        bool b_meta = !meta_path.empty() && load_meta_cache(meta_path, meta_key, meta);
+        bool b_vpm = !attr.filename_vpm_resampler_axmodedl.empty();
+        // vpm 只在需要 vpm_width/vpm_height 时才必须 init，缓存中有的话推迟到第一次用到图片
+        bool b_lazy_vpm = b_vpm && attr.b_lazy_vpm && b_meta && meta.contains("vpm_width") && meta.contains("vpm_height");
+        if (b_lazy_vpm)
+        {
+            _attr.vpm_width = meta["vpm_width"];
+            _attr.vpm_height = meta["vpm_height"];
+        }
+        vpm_ready = false;
+
+        file_loader_index.clear();
+        if (attr.b_async_read && !bundle.is_open())
+        {
+            // tokenizer init 的同时开始读文件
+            start_file_loader(attr, b_vpm && !b_lazy_vpm);
+        }
+        tokenizer = CreateTokenizer(attr.tokenizer_type);
+        if (!tokenizer->Init(attr.filename_tokenizer_model, attr.b_bos, attr.b_eos))
+        {
+            ALOGE("tokenizer.Init(%s, %d, %d) failed", attr.filename_tokenizer_model.c_str(), attr.b_bos, attr.b_eos);
+            return false;
+        }
+        update_cqdm(&cqdm, 0, "count", "tokenizer init ok");
+        // test code
+        // {
+        //     std::vector<int> output;
+        //     tokenizer.Encode("Today is National", output);
+        //     // print output
+        //     for (size_t i = 0; i < output.size(); i++)
+        //     {
+        //         printf("%d ", output[i]);
+        //     }
+        //     printf("\n");
+        // }
+
+        bool b_embed_ok;
+        if (bundle.is_open())
+        {
+            size_t size;
+            char *data = bundle.find("embed", &size);
+            b_embed_ok = data && embed_selector.Init(data, size, attr.tokens_embed_num, attr.tokens_embed_size, attr.b_use_mmap_load_embed);
+        }
+        else if (loaded_file(attr.filename_tokens_embed) >= 0)
+        {
+            int index = loaded_file(attr.filename_tokens_embed);
+            size_t size;
+            char *data = file_loader.Wait(index, &size);
+            b_embed_ok = data && embed_selector.Init(data, size, attr.tokens_embed_num, attr.tokens_embed_size, false);
+            file_loader.Release(index);
+        }
+        else
+        {
+            b_embed_ok = embed_selector.Init(attr.filename_tokens_embed, attr.tokens_embed_num, attr.tokens_embed_size, attr.b_use_mmap_load_embed, mmap_option(MADV_RANDOM));
+        }
+        if (!b_embed_ok)
+        {
+            ALOGE("embed_selector.Init(%s, %d, %d) failed", attr.filename_tokens_embed.c_str(), attr.tokens_embed_num, attr.tokens_embed_size);
+            return false;
+        }
+        update_cqdm(&cqdm, 1, "count", "embed_selector init ok");
+
+        if (!attr.trace_path.empty())
+        {
+#if defined(LLM_BACKEND_CPU)
+            ALOGW("cpu backend does not record trace, ignore %s", attr.trace_path.c_str());
+#else
+#if defined(LLM_BACKEND_REPLAY)
+            bool b_record = false;
+#else
+            bool b_record = true;
+#endif
+            if (ax_model_trace::get().open(attr.trace_path.c_str(), b_record, attr.b_trace_replay_timing) != 0)
+            {
+                ALOGE("open trace(%s) failed", attr.trace_path.c_str());
+                return false;
+            }
+#endif
+        }
+        // test code
+        // {
+        //     std::vector<unsigned short> embed = embed_selector.getByIndex(123);
+        //     printf("embed size: %d\n", embed.size());
+        //     for (int i = 0; i < embed.size(); i++)
+        //     {
+        //         bfloat16 bf16 = bfloat16(embed[i]);
+        //         float val = bf16;
+        //         printf("%d %0.22f\n", embed[i], val);
+        //     }
+        // }
+
+        llama_layers.resize(attr.axmodel_num);
+        decode_io.assign(attr.axmodel_num, LLMLayerIO());
+        layer_io_ready.assign(attr.axmodel_num, 0);
+        // prefill_layers.resize(attr.prefill_axmodel_num);
+
+        std::map<std::string, ax_runner_alloc_policy_e> layer_policy, post_policy;
+        if (!parse_alloc_policy(attr.io_alloc_policy, layer_policy, post_policy))
+        {
+            return false;
+        }
+        // 共用的 buffer 由第 0 层分配
+        auto layer0_policy = layer_policy;
+        for (auto &it : layer0_policy)
+        {
+            if (it.second == AX_RUNNER_ALLOC_SHARED)
+            {
+                it.second = AX_RUNNER_ALLOC_DEFAULT;
+            }
+        }
+
+#if !defined(LLM_BACKEND_CPU) && !defined(LLM_BACKEND_REPLAY)
+        ax_cmm_arena::get().set_block_size((size_t)std::max(attr.cmm_arena_block_mb, 0) << 20);
+#endif
+
+        char axmodel_path[1024];
+        for (int i = 0; i < attr.axmodel_num; i++)
+        {
+            sprintf(axmodel_path, attr.template_filename_axmodel.c_str(), i);
+            llama_layers[i].filename = axmodel_path;
+            llama_layers[i].layer.set_model_name(llama_layers[i].filename);
+            if (bundle.is_open())
             {
-                if (!attr.b_use_mmap_load_layer)
+                llama_layers[i].bundle_data = bundle.find("layer." + std::to_string(i), &llama_layers[i].bundle_size);
+                if (!llama_layers[i].bundle_data)
                 {
-                    if (!read_file(llama_layers[i].filename, llama_layers[i].layer_buffer_vec))
-                    {
-                        ALOGE("read_file(%s) failed", llama_layers[i].filename.c_str());
-                        return false;
-                    }
-                }
-                else
-                {
-                    llama_layers[i].layer_buffer.open_file(llama_layers[i].filename.c_str());
+                    ALOGE("layer.%d not in bundle(%s)", i, attr.bundle_path.c_str());
+                    return false;
                 }
-
-                sprintf(axmodel_path, "read_file %s ok", llama_layers[i].filename.c_str());
-                update_cqdm(&cqdm, i + 2, "count", axmodel_path);
             }
+            llama_layers[i].layer.set_alloc_policy(i == 0 ? layer0_policy : layer_policy);
+            // 带历史 kv 的 prefill group 和 decode 读同一份 kv cache
+            llama_layers[i].layer.set_group_shared_inputs({"K_cache", "V_cache"});
         }
 
-        int ret = llama_post.init(attr.filename_post_axmodel.c_str(), false);
-        if (ret != 0)
+        // 其它层的 io 要等第 0 层规划完才能确定，所以第 0 层先单独 init
+        if (!attr.b_dynamic_load_axmodel_layer)
         {
-            ALOGE("init post axmodel(%s) failed", attr.filename_post_axmodel.c_str());
-            return false;
+            std::string msg;
+            if (!init_layer(0, msg) || !plan_layer_io(layer_policy))
+            {
+                return false;
+            }
+            update_cqdm(&cqdm, 2, "count", msg.c_str());
         }
-        int remain_cmm = get_remaining_cmm_size();
-        sprintf(axmodel_path, "init post axmodel ok,remain_cmm(%d MB)", remain_cmm);
-        update_cqdm(&cqdm, attr.axmodel_num + 2, "count", axmodel_path);
 
-        if (_attr.b_vpm_two_stage)
+        // 剩下的层、post 和 vpm 互不依赖，在线程池中并行读文件和创建 handle，进度按顺序显示
+        std::vector<std::function<bool(std::string &)>> tasks;
+        std::vector<int> progress;
+        for (int i = attr.b_dynamic_load_axmodel_layer ? 0 : 1; i < attr.axmodel_num; i++)
         {
-            ret = vpm_encoder.init(attr.filename_vpm_encoder_axmodedl.c_str(), false);
-            if (ret != 0)
+            if (attr.b_dynamic_load_axmodel_layer)
             {
-                ALOGE("init vpm axmodel(%s) failed", attr.filename_vpm_encoder_axmodedl.c_str());
-                return false;
+                tasks.push_back([this, i](std::string &msg)
+                                { return read_layer(i, msg); });
             }
-
-            ret = vpm_resampler.init(attr.filename_vpm_resampler_axmodedl.c_str(), false);
-            if (ret != 0)
+            else
             {
-                ALOGE("init vpm axmodel(%s) failed", attr.filename_vpm_resampler_axmodedl.c_str());
-                return false;
+                tasks.push_back([this, i](std::string &msg)
+                                { return init_layer(i, msg); });
             }
-
-            _attr.vpm_height = vpm_encoder.get_input(0).vShape[1];
-            _attr.vpm_width = vpm_encoder.get_input(0).vShape[2];
+            progress.push_back(i + 2);
+        }
+        llama_post.set_alloc_policy(post_policy);
+        tasks.push_back([this](std::string &msg)
+                        { return init_post(msg); });
+        progress.push_back(attr.axmodel_num + 2);
+        if (b_lazy_vpm)
+        {
+            tasks.push_back([](std::string &msg)
+                            { msg = "vpm axmodel init on first image";
+                              return true; });
         }
         else
         {
-            ret = vpm_resampler.init(attr.filename_vpm_resampler_axmodedl.c_str(), false);
-            if (ret != 0)
-            {
-                ALOGE("init vpm axmodel(%s) failed", attr.filename_vpm_resampler_axmodedl.c_str());
-                return false;
-            }
-            _attr.vpm_height = vpm_resampler.get_input(0).vShape[1];
-            _attr.vpm_width = vpm_resampler.get_input(0).vShape[2];
+            tasks.push_back([this](std::string &msg)
+                            { return init_vpm(msg); });
         }
+        progress.push_back(attr.axmodel_num + 3);
 
-        remain_cmm = get_remaining_cmm_size();
-        sprintf(axmodel_path, "init vpm axmodel ok,remain_cmm(%d MB)", remain_cmm);
-        update_cqdm(&cqdm, attr.axmodel_num + 3, "count", axmodel_path);
+        if (!run_init_tasks(tasks, attr.init_threads, [&](int i, const std::string &msg)
+                            { update_cqdm(&cqdm, progress[i], "count", msg.c_str()); }))
+        {
+            file_loader.Stop();
+            return false;
+        }
+        if (!file_loader_index.empty())
+        {
+            double ms = file_loader.ElapsedMs();
+            size_t bytes = file_loader.ReadBytes();
+            printf("\n");
+            ALOGI("read %d files %.2f MB in %.2f ms(%.2f MB/s) with %s", (int)file_loader_index.size(), bytes / 1024.0 / 1024.0, ms,
+                  ms > 0 ? bytes / 1024.0 / 1024.0 / (ms / 1000) : 0.0, file_loader.Backend());
+            file_loader.Stop();
+            file_loader_index.clear();
+        }
 
-        if (attr.b_dynamic_load_axmodel_layer)
+        if (attr.b_compress_layer && attr.b_dynamic_load_axmodel_layer)
         {
-            // 加载第一层获取shape信息
-            auto &layer = llama_layers[0];
-            int ret;
-            if (_attr.b_use_mmap_load_layer)
-            {
-                ret = layer.layer.init((char *)layer.layer_buffer.data(), layer.layer_buffer.size());
-            }
-            else
+            size_t raw = 0, compressed = 0;
+            for (auto &layer : llama_layers)
             {
-                ret = layer.layer.init(layer.layer_buffer_vec.data(), layer.layer_buffer_vec.size());
+                raw += layer.raw_size;
+                compressed += layer.layer_buffer_vec.size();
             }
-            if (ret != 0)
+            printf("\n");
+            ALOGI("compressed layers: %.2f MB -> %.2f MB", raw / 1024.0 / 1024.0, compressed / 1024.0 / 1024.0);
+        }
+        else if (attr.b_compress_layer)
+        {
+            ALOGW("compress_layer only works with dynamic_load_axmodel_layer, ignored");
+        }
+        if (attr.filename_vpm_resampler_axmodedl.empty())
+        {
+            ALOGI("no vpm axmodel, text only");
+        }
+
+        if (attr.b_dynamic_load_axmodel_layer)
+        {
+            // 第 0 层的 io 要先规划，加载后直接作为已驻留的层交给 layer_loader，不再卸载后重新加载
+            if (!load_layer(0) || !plan_layer_io(layer_policy))
             {
-                ALOGE("init axmodel(%s) failed", layer.filename.c_str());
+                return false;
             }
         }
 
         {
-            _attr.max_token_len = llama_layers[0].layer.get_input("mask").nSize / sizeof(unsigned short) - 1;
+            _attr.max_token_len = decode_io[0].mask->nSize / sizeof(unsigned short) - 1;
             printf("\n");
             ALOGI("max_token_len : %d", _attr.max_token_len);
             // auto &input_k_cache = llama_layers[0].layer.get_input("K_cache");
             // auto &output_k_cache_out = llama_layers[0].layer.get_output("K_cache_out");
-            _attr.kv_cache_size = llama_layers[0].layer.get_output("K_cache_out").nSize / sizeof(unsigned short);
-            _attr.kv_cache_num = llama_layers[0].layer.get_input("K_cache").nSize / _attr.kv_cache_size / sizeof(unsigned short);
+            _attr.kv_cache_size = decode_io[0].k_cache_out->nSize / sizeof(unsigned short);
+            _attr.kv_cache_num = decode_io[0].k_cache->nSize / _attr.kv_cache_size / sizeof(unsigned short);
             ALOGI("kv_cache_size : %d, kv_cache_num: %d", _attr.kv_cache_size, _attr.kv_cache_num);
             if (_attr.max_token_len > _attr.kv_cache_num)
             {
@@ -263,18 +1966,87 @@ public:
                 return false;
             }
 
-            _attr.prefill_token_num = llama_layers[0].layer.get_input(prefill_grpid, "indices").vShape[1];
+            _attr.prefill_token_num = 0;
+            for (auto &g : prefill_groups)
+            {
+                _attr.prefill_token_num = std::max(_attr.prefill_token_num, g.token_num);
+                ALOGI("prefill group %d: token_num %d, history %d", g.grpid, g.token_num, g.history);
+                if (g.history == 0)
+                {
+                    // 不带 history 的 prefill 的 causal mask 与输入无关，只在 init 时生成一次
+                    write_prefill_mask(g, 0);
+                }
+            }
             ALOGI("prefill_token_num : %d", _attr.prefill_token_num);
 
             ALOGI("vpm_height : %d,vpm_width : %d", _attr.vpm_height, _attr.vpm_width);
         }
+        if (!meta_path.empty() && !meta_key.is_null())
+        {
+            nlohmann::json cur = {{"version", 1},
+                                  {"files", meta_key},
+                                  {"axmodel_num", _attr.axmodel_num},
+                                  {"max_token_len", _attr.max_token_len},
+                                  {"kv_cache_size", _attr.kv_cache_size},
+                                  {"kv_cache_num", _attr.kv_cache_num},
+                                  {"prefill_token_num", _attr.prefill_token_num}};
+            if (b_vpm)
+            {
+                cur["vpm_width"] = _attr.vpm_width;
+                cur["vpm_height"] = _attr.vpm_height;
+            }
+            if (b_meta && cur != meta)
+            {
+                ALOGW("meta cache(%s) does not match the models, rewrite", meta_path.c_str());
+            }
+            if (!b_meta || cur != meta)
+            {
+                save_meta_cache(meta_path, cur);
+            }
+        }
         if (attr.b_dynamic_load_axmodel_layer)
         {
-            auto &layer = llama_layers[0];
-            layer.layer.deinit();
+            std::vector<size_t> layer_cost;
+            for (auto &layer : llama_layers)
+            {
+                if (layer.raw_size || layer.bundle_data)
+                {
+                    layer_cost.push_back(layer.raw_size ? layer.raw_size : layer.bundle_size);
+                }
+                else
+                {
+                    layer_cost.push_back(_attr.b_use_mmap_load_layer ? layer.layer_buffer.size() : layer.layer_buffer_vec.size());
+                }
+            }
+            layer_loader.Start(layer_cost, (size_t)std::max(attr.dynamic_layer_budget_mb, 0) << 20, attr.dynamic_layer_prefetch,
+                               [this](int m)
+                               { return load_layer(m); },
+                               [this](int m)
+                               { llama_layers[m].layer.deinit(); },
+                               {0});
+            // 等待输入的同时加载前几层
+            layer_loader.Prefetch(0);
+        }
+
+#if !defined(LLM_BACKEND_CPU) && !defined(LLM_BACKEND_REPLAY)
+        ax_cmm_arena::get().print_summary();
+#endif
+        if (attr.b_mmap_warmup)
+        {
+            warmup_mmap();
+        }
+
+        size_t prefix_row_bytes = sizeof(unsigned short) * _attr.kv_cache_size * 2 * _attr.axmodel_num;
+        if (prefix_cache.Init((size_t)std::max(attr.prefix_cache_mb, 0) << 20, prefix_row_bytes))
+        {
+            ALOGI("prefix cache: %d MB, %d tokens", attr.prefix_cache_mb, prefix_cache.Capacity());
+        }
+        else if (attr.prefix_cache_mb > 0)
+        {
+            ALOGW("prefix cache(%d MB) smaller than one token(%d bytes), disabled", attr.prefix_cache_mb, (int)prefix_row_bytes);
         }
 
-        // Reset();
+        Reset();
         ALOGI("LLM init ok");
         return true;
     }
@@ -286,6 +2058,8 @@ public:
 
     void Deinit()
     {
+        layer_loader.Stop();
+        file_loader.Stop();
         for (int i = 0; i < _attr.axmodel_num; i++)
         {
             llama_layers[i].layer.release();
@@ -293,7 +2067,14 @@ public:
         llama_post.release();
         vpm_encoder.release();
         vpm_resampler.release();
+        vpm_ready = false;
+        Reset();
+#if !defined(LLM_BACKEND_CPU) && !defined(LLM_BACKEND_REPLAY)
+        ax_cmm_arena::get().trim();
+#endif
         embed_selector.Deinit();
+        bundle.close_file();
+        ax_model_trace::get().close();
     }
 
     void Stop()
@@ -301,8 +2082,221 @@ public:
         b_stop = true;
     }
 
+    // 结束当前会话，下一次 Run 从头开始 prefill；Run 默认接着上一次的 kv cache 继续
+    void Reset()
+    {
+        kv_pos = 0;
+        pending_token = -1;
+        session_tokens.clear();
+    }
+
+    // 会话中已经在 kv cache 里的 token 数
+    int SessionLength()
+    {
+        return kv_pos;
+    }
+
+    const std::vector<int> &SessionTokens()
+    {
+        return session_tokens;
+    }
+
+    // 把当前会话(各层 kv cache 的前 kv_pos 行、生成的 token、采样器的随机数状态)保存到文件，b_int8 时 kv 按行量化为 int8
+    // 先写临时文件再 rename，写到一半断电时原来的文件不受影响
+    bool SaveSession(const std::string &path, bool b_int8 = false)
+    {
+        if (!ensure_layer_io())
+        {
+            return false;
+        }
+        timer t;
+        t.start();
+        nlohmann::json meta;
+        meta["files"] = meta_cache_key(_attr);
+        meta["rng"] = postprocess.get_rng_state();
+        std::string meta_str = meta.dump();
+
+        int dtype = b_int8 ? AX_SESSION_KV_INT8 : AX_SESSION_KV_BF16;
+        size_t block = session_kv_block_size(dtype, kv_pos, _attr.kv_cache_size);
+        ax_session_header_t hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, AX_SESSION_MAGIC, sizeof(hdr.magic));
+        hdr.version = AX_SESSION_VERSION;
+        hdr.kv_dtype = dtype;
+        hdr.axmodel_num = _attr.axmodel_num;
+        hdr.kv_cache_size = _attr.kv_cache_size;
+        hdr.kv_len = kv_pos;
+        hdr.pending_token = pending_token;
+        hdr.token_num = session_tokens.size();
+        hdr.meta_size = meta_str.size();
+        size_t head = sizeof(hdr) + meta_str.size() + session_tokens.size() * sizeof(int32_t);
+        hdr.kv_offset = (head + AX_SESSION_ALIGN - 1) / AX_SESSION_ALIGN * AX_SESSION_ALIGN;
+        hdr.kv_size = block * 2 * _attr.axmodel_num;
+
+        std::string tmp = path + ".tmp";
+        FILE *fp = fopen(tmp.c_str(), "wb");
+        if (!fp)
+        {
+            ALOGE("open session file(%s) failed", tmp.c_str());
+            return false;
+        }
+        std::vector<char> pad(hdr.kv_offset - head, 0);
+        std::vector<int32_t> tokens(session_tokens.begin(), session_tokens.end());
+        bool ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+                  fwrite(meta_str.data(), 1, meta_str.size(), fp) == meta_str.size() &&
+                  fwrite(tokens.data(), sizeof(int32_t), tokens.size(), fp) == tokens.size() &&
+                  fwrite(pad.data(), 1, pad.size(), fp) == pad.size();
+
+        size_t row_bytes = sizeof(unsigned short) * _attr.kv_cache_size;
+        std::vector<char> packed(block);
+        with_layer_io([&]()
+                      {
+            ok = ok && all_layer_io_ready();
+            for (int m = 0; m < _attr.axmodel_num && ok; m++)
+            {
+                auto &layer = llama_layers[m].layer;
+                for (auto kv : {decode_io[m].k_cache, decode_io[m].v_cache})
+                {
+                    layer.cache_invalidate(*kv, 0, kv_pos * row_bytes);
+                    session_pack_kv(dtype, (unsigned short *)kv->pVirAddr, kv_pos, _attr.kv_cache_size, packed.data());
+                    ok = ok && fwrite(packed.data(), 1, block, fp) == block;
+                }
+            } });
+        ok = fclose(fp) == 0 && ok;
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+        {
+            ALOGE("save session(%s) failed", path.c_str());
+            remove(tmp.c_str());
+            return false;
+        }
+        ALOGI("save session(%s): %d tokens, kv %s %.2f MB, %.2f ms", path.c_str(), kv_pos, b_int8 ? "int8" : "bf16",
+              hdr.kv_size / 1024.0 / 1024.0, t.cost());
+        return true;
+    }
+
+    // mmap 保存的会话并把 kv 拷回 kv cache，之后的 Run 接着这个会话；模型文件或者 kv 的 shape 不一致时返回 false，当前会话不变
+    bool LoadSession(const std::string &path)
+    {
+        timer t;
+        t.start();
+        MMap map;
+        MMap::option_t opt;
+        opt.advice = MADV_SEQUENTIAL;
+        if (!map.open_file(path.c_str(), opt))
+        {
+            ALOGE("open session file(%s) failed", path.c_str());
+            return false;
+        }
+        const char *add = (const char *)map.data();
+        size_t size = map.size();
+        ax_session_header_t hdr;
+        if (size < sizeof(hdr))
+        {
+            ALOGE("session file(%s) too small", path.c_str());
+            return false;
+        }
+        memcpy(&hdr, add, sizeof(hdr));
+        if (memcmp(hdr.magic, AX_SESSION_MAGIC, sizeof(hdr.magic)) != 0 || hdr.version != AX_SESSION_VERSION ||
+            (hdr.kv_dtype != AX_SESSION_KV_BF16 && hdr.kv_dtype != AX_SESSION_KV_INT8))
+        {
+            ALOGE("session file(%s) bad magic or version(%d)", path.c_str(), hdr.version);
+            return false;
+        }
+        size_t block = session_kv_block_size(hdr.kv_dtype, hdr.kv_len, hdr.kv_cache_size);
+        size_t head = sizeof(hdr) + hdr.meta_size + (size_t)hdr.token_num * sizeof(int32_t);
+        if (hdr.meta_size > size || head > hdr.kv_offset || hdr.kv_offset > size || hdr.kv_size > size - hdr.kv_offset ||
+            hdr.kv_size != block * 2 * hdr.axmodel_num)
+        {
+            ALOGE("session file(%s) truncated", path.c_str());
+            return false;
+        }
+        if ((int)hdr.axmodel_num != _attr.axmodel_num || (int)hdr.kv_cache_size != _attr.kv_cache_size ||
+            (int)hdr.kv_len > _attr.max_token_len || (int)hdr.kv_len > _attr.kv_cache_num)
+        {
+            ALOGE("session file(%s) does not match the model: %d layers, kv %d x %d", path.c_str(), hdr.axmodel_num, hdr.kv_len, hdr.kv_cache_size);
+            return false;
+        }
+        // 恢复的会话要能接上新的输入(上一轮最后的 token 和至少一个新 token)，不能接上时不恢复，而不是在下一次输入时丢掉
+        std::vector<std::pair<int, int>> chunks;
+        if (hdr.kv_len > 0 && !plan_prefill_chunks(hdr.kv_len, hdr.pending_token >= 0 ? 2 : 1, chunks))
+        {
+            ALOGE("session file(%s): no room after %d tokens in kv cache(%d) to continue", path.c_str(), hdr.kv_len, _attr.max_token_len);
+            return false;
+        }
+        auto meta = nlohmann::json::parse(add + sizeof(hdr), add + sizeof(hdr) + hdr.meta_size, nullptr, false);
+        if (!meta.is_object() || !meta.contains("files") || meta["files"] != meta_cache_key(_attr))
+        {
+            ALOGE("session file(%s) saved with other model files", path.c_str());
+            return false;
+        }
+        std::mt19937 rng;
+        if (!meta.contains("rng") || !meta["rng"].is_string() || !LLMPostprocess::parse_rng_state(meta["rng"], rng))
+        {
+            ALOGE("session file(%s) bad rng state", path.c_str());
+            return false;
+        }
+        if (!ensure_layer_io())
+        {
+            return false;
+        }
+
+        bool b_loaded = false;
+        size_t row_bytes = sizeof(unsigned short) * _attr.kv_cache_size;
+        with_layer_io([&]()
+                      {
+            if (!all_layer_io_ready())
+            {
+                return;
+            }
+            const char *kv_data = add + hdr.kv_offset;
+            for (int m = 0; m < _attr.axmodel_num; m++)
+            {
+                auto &layer = llama_layers[m].layer;
+                for (auto kv : {decode_io[m].k_cache, decode_io[m].v_cache})
+                {
+                    session_unpack_kv(hdr.kv_dtype, kv_data, hdr.kv_len, _attr.kv_cache_size, (unsigned short *)kv->pVirAddr);
+                    layer.cache_flush(*kv, 0, hdr.kv_len * row_bytes);
+                    kv_data += block;
+                }
+            }
+            b_loaded = true; });
+        if (!b_loaded)
+        {
+            ALOGE("load session(%s) failed, layer io not ready", path.c_str());
+            return false;
+        }
+        postprocess.set_rng(rng);
+        session_tokens.resize(hdr.token_num);
+        memcpy(session_tokens.data(), add + sizeof(hdr) + hdr.meta_size, hdr.token_num * sizeof(int32_t));
+
+        // decode mask 只打开会话中的位置
+        close_decode_mask();
+        if (hdr.kv_len > 0)
+        {
+            open_decode_mask(0, hdr.kv_len);
+        }
+        kv_pos = hdr.kv_len;
+        pending_token = hdr.pending_token;
+        ALOGI("load session(%s): %d tokens, kv %s, %.2f ms", path.c_str(), kv_pos, hdr.kv_dtype == AX_SESSION_KV_INT8 ? "int8" : "bf16", t.cost());
+        return true;
+    }
+
     int Encode(cv::Mat src, std::vector<unsigned short> &out_embed)
     {
+        if (_attr.filename_vpm_resampler_axmodedl.empty())
+        {
+            ALOGE("vpm axmodel not loaded");
+            return -1;
+        }
+        if (!vpm_ready)
+        {
+            std::string msg;
+            if (!init_vpm(msg))
+            {
+                return -1;
+            }
+            ALOGI("%s", msg.c_str());
+        }
         timer t;
         t.start();
         cv::Mat dst;
@@ -313,19 +2307,22 @@ public:
         {
             void *data = vpm_encoder.get_input(0).pVirAddr;
             memcpy(data, dst.data, dst.rows * dst.cols * 3);
+            vpm_encoder.cache_flush(vpm_encoder.get_input(0), 0, dst.rows * dst.cols * 3);
             vpm_encoder.inference();
-            AX_SYS_MinvalidateCache(vpm_encoder.get_output(0).phyAddr, vpm_encoder.get_output(0).pVirAddr, vpm_encoder.get_output(0).nSize);
+            vpm_encoder.cache_invalidate(vpm_encoder.get_output(0));
             memcpy(vpm_resampler.get_input(0).pVirAddr, vpm_encoder.get_output(0).pVirAddr, vpm_encoder.get_output(0).nSize);
+            vpm_resampler.cache_flush(vpm_resampler.get_input(0), 0, vpm_encoder.get_output(0).nSize);
         }
         else
         {
             void *data = vpm_resampler.get_input(0).pVirAddr;
             memcpy(data, dst.data, dst.rows * dst.cols * 3);
+            vpm_resampler.cache_flush(vpm_resampler.get_input(0), 0, dst.rows * dst.cols * 3);
         }
 
         vpm_resampler.inference();
         out_embed.resize(vpm_resampler.get_output(0).nSize / sizeof(float));
-        AX_SYS_MinvalidateCache(vpm_resampler.get_output(0).phyAddr, vpm_resampler.get_output(0).pVirAddr, vpm_resampler.get_output(0).nSize);
+        vpm_resampler.cache_invalidate(vpm_resampler.get_output(0));
 
         float *output_data = (float *)vpm_resampler.get_output(0).pVirAddr;
         for (size_t i = 0; i < out_embed.size(); i++)
@@ -340,10 +2337,11 @@ public:
 
     int Encode(std::vector<unsigned short> &out_embed, std::string prompt = "What is in the image?")
     {
-        std::vector<int> input_ids = tokenizer->Encode(prompt, false);
-        if (input_ids.size() > _attr.prefill_token_num)
+        std::vector<int> input_ids = encode_prompt(prompt, false);
+        // 超过 prefill_token_num 的输入在 Run 中分段 prefill
+        if ((int)input_ids.size() >= _attr.max_token_len)
         {
-            ALOGE("input_ids(%d) > prefill_token_num(%d)", input_ids.size(), _attr.prefill_token_num);
+            ALOGE("input_ids(%d) >= max_token_len(%d)", (int)input_ids.size(), _attr.max_token_len);
             return -1;
         }
         out_embed.resize(input_ids.size() * _attr.tokens_embed_size);
@@ -360,7 +2358,7 @@ public:
 
     int Encode(std::vector<unsigned short> &img_embed, std::vector<unsigned short> &out_embed, std::string prompt = "What is in the image?", const unsigned int img_token_id = 49190)
     {
-        std::vector<int> input_ids = tokenizer->Encode(prompt, true);
+        std::vector<int> input_ids = encode_prompt(prompt, true);
 
         // constexpr int img_token_id = 49190;	// smolvlm
         // constexpr int img_token_id = 151667; // InternVL2.5
@@ -381,9 +2379,10 @@ public:
         // }
         // printf("\n");
 
-        if (input_ids.size() > _attr.prefill_token_num)
+        // 超过 prefill_token_num 的输入在 Run 中分段 prefill
+        if ((int)input_ids.size() >= _attr.max_token_len)
         {
-            ALOGE("input_ids(%d) > prefill_token_num(%d)", input_ids.size(), _attr.prefill_token_num);
+            ALOGE("input_ids(%d) >= max_token_len(%d)", (int)input_ids.size(), _attr.max_token_len);
             return -1;
         }
         out_embed.resize(input_ids.size() * _attr.tokens_embed_size);
@@ -409,99 +2408,105 @@ public:
         b_stop = false;
         std::string final_out;
 
-        bfloat16 bf16 = -65536.f;
-        std::vector<unsigned short> mask(_attr.kv_cache_num + 1, bf16.data);
-        std::vector<unsigned short> mask_p(_attr.prefill_token_num * _attr.prefill_token_num, bf16.data);
-
-        for (size_t i = 0; i < _attr.prefill_token_num; i++)
-        {
-            for (size_t j = 0; j < i + 1; j++)
-            {
-                mask_p[i * _attr.prefill_token_num + j] = 0;
-            }
-        }
-
         std::vector<int> cached_token;
         std::vector<int> token_ids;
         // std::vector<int> token_ids = tokenizer->Encode(input_str);
         // int len_of_input = token_ids.size();
-        int input_embed_num = test_embed.size() / _attr.tokens_embed_size;
-        // ALOGI("input_embed_num(%d)", input_embed_num);
 
-        mask[_attr.kv_cache_num] = 0;
-        for (size_t i = 0; i < input_embed_num; i++)
-        {
-            mask[i] = 0;
-        }
         timer t_cost;
         timer ttft_timer;
         ttft_timer.start();
+        reset_cache_stats();
+        layer_loader.ResetStats();
 
-        for (unsigned int m = 0; m < _attr.axmodel_num; m++)
+        // 新的输入接在会话之后，上一轮最后采样的 token 先补上；放不下时开始新的会话
+        if (kv_pos > 0 && pending_token >= 0)
         {
-            if (b_stop)
+            std::vector<unsigned short> embed(_attr.tokens_embed_size);
+            embed_selector.getByIndex(pending_token, embed);
+            test_embed.insert(test_embed.begin(), embed.begin(), embed.end());
+        }
+        int input_embed_num = test_embed.size() / _attr.tokens_embed_size;
+        // 超过 prefill group 的输入按 group 的大小分段，后面的段接在前面写入的 kv 之后
+        std::vector<std::pair<int, int>> chunks;
+        double plan_cost = 0;
+        if (kv_pos > 0 && !plan_prefill_chunks(kv_pos, input_embed_num, chunks, &plan_cost))
+        {
+            ALOGW("%d tokens do not fit after %d tokens of the session, start a new session", input_embed_num, kv_pos);
+            if (pending_token >= 0)
             {
-                break;
+                test_embed.erase(test_embed.begin(), test_embed.begin() + _attr.tokens_embed_size);
+                input_embed_num--;
             }
+            Reset();
+        }
+        if (kv_pos == 0 && !plan_prefill_chunks(0, input_embed_num, chunks, &plan_cost))
+        {
+            ALOGE("%d tokens do not fit in kv cache(%d)", input_embed_num, _attr.max_token_len);
+            return final_out;
+        }
+        // base 为本次输入在 kv cache 中的起始位置，start 为实际开始 prefill 的位置(跳过从前缀缓存恢复的部分)
+        int base = kv_pos;
+        pending_token = -1;
 
-            auto &layer = llama_layers[m];
-            auto &layer_llama = llama_layers[m];
+        // decode 的 mask 由所有层共用，每段 prefill 之后只把新的位置置 0，会话中已有的位置保持打开
+        if (base == 0)
+        {
+            close_decode_mask();
+        }
 
-            if (_attr.b_dynamic_load_axmodel_layer)
+        int start = base;
+        std::vector<uint64_t> keys;
+        if (base == 0 && prefix_cache.Enabled())
+        {
+            keys = prefix_keys(test_embed, input_embed_num);
+            start = restore_prefix(keys, input_embed_num, chunks, plan_cost);
+        }
+        if (start > 0 || chunks.size() > 1)
+        {
+            std::string desc;
+            for (auto &chunk : chunks)
             {
-                int ret;
-                if (_attr.b_use_mmap_load_layer)
-                {
-                    ret = layer.layer.init((char *)layer.layer_buffer.data(), layer.layer_buffer.size());
-                }
-                else
-                {
-                    ret = layer.layer.init(layer.layer_buffer_vec.data(), layer.layer_buffer_vec.size());
-                }
-                if (ret != 0)
-                {
-                    ALOGE("init axmodel(%s) failed", layer.filename.c_str());
-                }
+                desc += chunk.first < 0 ? " decode:" : " group" + std::to_string(prefill_groups[chunk.first].grpid) + ":";
+                desc += std::to_string(chunk.second);
             }
+            ALOGI("prefill %d tokens after %d tokens of the session,%s, estimated cost %.2f", input_embed_num - (start - base), start, desc.c_str(), plan_cost);
+        }
 
-            auto &input_indices = layer.layer.get_input(prefill_grpid, "indices");
-            unsigned int *input_indices_ptr = (unsigned int *)input_indices.pVirAddr;
-            for (unsigned int i = 0; i < input_embed_num; i++)
+        int pos = start;
+        for (auto &chunk : chunks)
+        {
+            const unsigned short *embed = test_embed.data() + (size_t)(pos - base) * _attr.tokens_embed_size;
+            bool ok;
+            if (chunk.first < 0)
             {
-                input_indices_ptr[i] = i;
+                ok = decode_chunk(pos, embed, chunk.second);
             }
-
-            auto &input_mask = layer.layer.get_input(prefill_grpid, "mask");
-            memcpy(input_mask.pVirAddr, mask_p.data(), mask_p.size() * sizeof(unsigned short));
-
-            auto &input_input = layer.layer.get_input(prefill_grpid, "input");
-            memcpy(input_input.pVirAddr, test_embed.data(), test_embed.size() * sizeof(unsigned short));
-            if (m == 0)
+            else
             {
-                test_embed.resize(_attr.prefill_token_num * _attr.tokens_embed_size);
+                auto &group = prefill_groups[chunk.first];
+                timer t;
+                t.start();
+                ok = prefill_chunk(group, pos, embed, chunk.second);
+                if (ok)
+                {
+                    update_cost(group.cost_ms, t.cost());
+                    open_decode_mask(pos, chunk.second);
+                }
             }
-
-            layer.layer.inference(prefill_grpid);
-
-            auto &output_k_cache = layer.layer.get_output(prefill_grpid, "K_cache_out");
-            AX_SYS_MinvalidateCache(output_k_cache.phyAddr, output_k_cache.pVirAddr, output_k_cache.nSize);
-            auto &input_k_cache = layer_llama.layer.get_input(decode_grpid, "K_cache");
-            memcpy(input_k_cache.pVirAddr, output_k_cache.pVirAddr, sizeof(unsigned short) * _attr.prefill_token_num * _attr.kv_cache_size);
-
-            auto &output_v_cache = layer.layer.get_output(prefill_grpid, "V_cache_out");
-            AX_SYS_MinvalidateCache(output_v_cache.phyAddr, output_v_cache.pVirAddr, output_v_cache.nSize);
-            auto &input_v_cache = layer_llama.layer.get_input(decode_grpid, "V_cache");
-            memcpy(input_v_cache.pVirAddr, output_v_cache.pVirAddr, sizeof(unsigned short) * _attr.prefill_token_num * _attr.kv_cache_size);
-
-            auto &output = layer.layer.get_output(prefill_grpid, "output");
-            AX_SYS_MinvalidateCache(output.phyAddr, output.pVirAddr, output.nSize);
-            memcpy(test_embed.data(), output.pVirAddr, test_embed.size() * sizeof(unsigned short));
-            if (_attr.b_dynamic_load_axmodel_layer)
+            if (!ok)
             {
-                layer.layer.deinit();
+                // 没有完成所有层，kv cache 不完整
+                if (!b_stop)
+                {
+                    ALOGE("prefill %d tokens at %d failed, session reset", chunk.second, pos);
+                }
+                Reset();
+                return final_out;
             }
-            // ALOGI("%f %f %f %f %f", bfloat16(embed[0]).fp32(), bfloat16(embed[1]).fp32(), bfloat16(embed[2]).fp32(), bfloat16(embed[3]).fp32(), bfloat16(embed[4]).fp32());
+            pos += chunk.second;
         }
+        kv_pos = pos;
 
         // ALOGI("prefill time cost: %.2f s", t_cost.cost() / 1000);
 
@@ -517,27 +2522,37 @@ public:
         t_cqdm cqdm = create_cqdm(_attr.max_token_len, 32);
         std::vector<unsigned short> embed(_attr.tokens_embed_size, 0);
 
-        memcpy(embed.data(),
-               test_embed.data() + (input_embed_num - 1) * _attr.tokens_embed_size,
-               _attr.tokens_embed_size * sizeof(unsigned short));
-
         {
+            // post 直接读最后一层输出中最后一个 token 的那一行，地址不对齐时拷贝到 post 自己的 input
+            // 最后一段用 decode 送入时就是 decode 的输出
+            bool b_decode_last = chunks.back().first < 0;
+            auto last = b_decode_last ? decode_plan.act[_attr.axmodel_num] : prefill_groups[chunks.back().first].plan.act[_attr.axmodel_num];
+            int last_num = b_decode_last ? 1 : chunks.back().second;
+            unsigned long offset = (unsigned long)(last_num - 1) * post_io.own_input.nSize;
+            if (offset % AX_RUNNER_IO_ALIGN_SIZE == 0)
+            {
+                llama_post.set_input_buffer(0, post_io.input->nIdx, *last, offset);
+            }
+            else
+            {
+                llama_post.set_input_buffer(0, post_io.input->nIdx, post_io.own_input);
+                llama_layers[0].layer.cache_invalidate(*last, offset, post_io.input->nSize);
+                memcpy(post_io.input->pVirAddr, (char *)last->pVirAddr + offset, post_io.input->nSize);
+                llama_post.cache_flush(*post_io.input);
+            }
 
             // post process
-            auto &input = llama_post.get_input("input");
-            memcpy(input.pVirAddr, embed.data(), embed.size() * sizeof(unsigned short));
             llama_post.inference();
             int max_index;
             if (_attr.b_use_topk)
             {
-                AX_SYS_MinvalidateCache(llama_post.get_output("indices").phyAddr, llama_post.get_output("indices").pVirAddr, llama_post.get_output("indices").nSize);
-                max_index = *(int *)llama_post.get_output("indices").pVirAddr;
+                llama_post.cache_invalidate(*post_io.indices);
+                max_index = *(int *)post_io.indices->pVirAddr;
             }
             else
             {
-                auto &output_post = llama_post.get_output("output");
-                AX_SYS_MinvalidateCache(output_post.phyAddr, output_post.pVirAddr, output_post.nSize);
-                unsigned short *post_out = (unsigned short *)output_post.pVirAddr;
+                llama_post.cache_invalidate(*post_io.output);
+                unsigned short *post_out = (unsigned short *)post_io.output->pVirAddr;
                 float max_val = -MAXFLOAT;
                 max_index = post_process(postprocess, post_out, _attr.tokens_embed_num, token_ids, &max_val);
             }
@@ -547,10 +2562,43 @@ public:
             cached_token.push_back(max_index);
             ALOGI("ttft: %.2f ms", ttft_timer.cost());
         }
+        report_cache_stats("prefill", 1);
+        if (!keys.empty())
+        {
+            save_prefix(keys, input_embed_num);
+            auto &st = prefix_cache.Stats();
+            ALOGI("prefix cache: %d of %d tokens restored, %d/%d sessions hit, %ld/%ld tokens hit, %d/%d rows used, %ld evicted",
+                  start, input_embed_num, st.hits, st.lookups, st.hit_tokens, st.lookup_tokens, prefix_cache.Size(), prefix_cache.Capacity(), st.evicted);
+        }
+        int decode_steps = 0;
         t_cost.start();
 
+        bool b_cached_token_ready = false;
+        auto flush_cached_token = [&]()
+        {
+            float t_cost_ms = t_cost.cost();
+            float token_per_sec = token_ids.size() / (t_cost_ms / 1000);
+            auto tmp_out = tokenizer->Decode(cached_token);
+            _attr.runing_callback(cached_token.data(), cached_token.size(), tmp_out.c_str(), token_per_sec, _attr.reserve);
+            cached_token.clear();
+            b_cached_token_ready = false;
+        };
+
+        // decode 时 post 的输入固定为最后一层的输出
+        auto last_decode = decode_plan.act[_attr.axmodel_num];
+        llama_post.set_input_buffer(0, post_io.input->nIdx, *last_decode);
+
+        // 在下一个 token 第一层推理期间回调，tokenizer decode 与 npu 并行
+        auto flush_on_submit = [&]()
+        {
+            if (b_cached_token_ready)
+            {
+                flush_cached_token();
+            }
+        };
+
         bool b_hit_eos = false;
-        for (unsigned int indices = input_embed_num; indices < _attr.max_token_len; indices++)
+        for (unsigned int indices = kv_pos; indices < _attr.max_token_len; indices++)
         {
             if (b_stop)
             {
@@ -561,85 +2609,40 @@ public:
             embed_selector.getByIndex(next_token, embed);
             // ALOGI("%f %f %f %f %f", bfloat16(embed[0]).fp32(), bfloat16(embed[1]).fp32(), bfloat16(embed[2]).fp32(), bfloat16(embed[3]).fp32(), bfloat16(embed[4]).fp32());
 
-            for (int m = 0; m < _attr.axmodel_num; m++)
+            timer step_timer;
+            step_timer.start();
+            bool b_done = decode_layers(indices, embed.data(), flush_on_submit);
+            // ALOGI("");
+            if (!b_done && !b_stop)
             {
-                if (b_stop)
-                {
-                    break;
-                }
-
-                auto &layer = llama_layers[m];
-
-                if (_attr.b_dynamic_load_axmodel_layer)
-                {
-                    int ret;
-                    if (_attr.b_use_mmap_load_layer)
-                    {
-                        ret = layer.layer.init((char *)layer.layer_buffer.data(), layer.layer_buffer.size());
-                    }
-                    else
-                    {
-                        ret = layer.layer.init(layer.layer_buffer_vec.data(), layer.layer_buffer_vec.size());
-                    }
-                    if (ret != 0)
-                    {
-                        ALOGE("init axmodel(%s) failed", layer.filename.c_str());
-                    }
-                }
-
-                auto &input_k_cache = layer.layer.get_input(decode_grpid, "K_cache");
-                unsigned short *input_k_cache_ptr = (unsigned short *)input_k_cache.pVirAddr;
-                // memcpy(input_k_cache.pVirAddr, k_caches[m].data(), sizeof(unsigned short) * k_caches[m].size());
-                auto &input_v_cache = layer.layer.get_input(decode_grpid, "V_cache");
-                unsigned short *input_v_cache_ptr = (unsigned short *)input_v_cache.pVirAddr;
-                // memcpy(input_v_cache.pVirAddr, v_caches[m].data(), sizeof(unsigned short) * v_caches[m].size());
-
-                auto &input_indices = layer.layer.get_input(decode_grpid, "indices");
-                memcpy(input_indices.pVirAddr, &indices, sizeof(indices));
-
-                auto &input_mask = layer.layer.get_input(decode_grpid, "mask");
-                memcpy(input_mask.pVirAddr, mask.data(), mask.size() * sizeof(unsigned short));
-
-                auto &input_input = layer.layer.get_input(decode_grpid, "input");
-                memcpy(input_input.pVirAddr, embed.data(), embed.size() * sizeof(unsigned short));
-
-                layer.layer.inference(decode_grpid);
-
-                auto &output_k_cache = layer.layer.get_output(decode_grpid, "K_cache_out");
-                AX_SYS_MinvalidateCache(output_k_cache.phyAddr, output_k_cache.pVirAddr, output_k_cache.nSize);
-                memcpy(input_k_cache_ptr + indices * _attr.kv_cache_size, output_k_cache.pVirAddr, sizeof(unsigned short) * _attr.kv_cache_size);
-
-                auto &output_v_cache = layer.layer.get_output(decode_grpid, "V_cache_out");
-                AX_SYS_MinvalidateCache(output_v_cache.phyAddr, output_v_cache.pVirAddr, output_v_cache.nSize);
-                memcpy(input_v_cache_ptr + indices * _attr.kv_cache_size, output_v_cache.pVirAddr, sizeof(unsigned short) * _attr.kv_cache_size);
-
-                auto &output = layer.layer.get_output(decode_grpid, "output");
-                AX_SYS_MinvalidateCache(output.phyAddr, output.pVirAddr, output.nSize);
-                memcpy(embed.data(), output.pVirAddr, embed.size() * sizeof(unsigned short));
-                if (_attr.b_dynamic_load_axmodel_layer)
-                {
-                    layer.layer.deinit();
-                }
-                // ALOGI("%f %f %f %f %f", bfloat16(embed[0]).fp32(), bfloat16(embed[1]).fp32(), bfloat16(embed[2]).fp32(), bfloat16(embed[3]).fp32(), bfloat16(embed[4]).fp32());
+                // 出错时 kv cache 中这一行的状态不确定，结束会话
+                ALOGE("decode token %u failed, session reset", indices);
+                Reset();
+                return final_out;
             }
-            // ALOGI("");
-            mask[indices] = 0;
+            if (!b_done)
+            {
+                // 这个 token 没有经过所有层，不计入会话，下一轮重新送入
+                break;
+            }
+            update_cost(decode_cost_ms, step_timer.cost());
+            // 所有层都已完成，可以直接修改共用的 mask
+            open_decode_mask(indices, 1);
+            kv_pos = indices + 1;
+            decode_steps++;
             {
                 // post process
-                auto &input = llama_post.get_input("input");
-                memcpy(input.pVirAddr, embed.data(), embed.size() * sizeof(unsigned short));
                 llama_post.inference();
                 int max_index;
                 if (_attr.b_use_topk)
                 {
-                    AX_SYS_MinvalidateCache(llama_post.get_output("indices").phyAddr, llama_post.get_output("indices").pVirAddr, llama_post.get_output("indices").nSize);
-                    max_index = *(int *)llama_post.get_output("indices").pVirAddr;
+                    llama_post.cache_invalidate(*post_io.indices);
+                    max_index = *(int *)post_io.indices->pVirAddr;
                 }
                 else
                 {
-                    auto &output_post = llama_post.get_output("output");
-                    AX_SYS_MinvalidateCache(output_post.phyAddr, output_post.pVirAddr, output_post.nSize);
-                    unsigned short *post_out = (unsigned short *)output_post.pVirAddr;
+                    llama_post.cache_invalidate(*post_io.output);
+                    unsigned short *post_out = (unsigned short *)post_io.output->pVirAddr;
                     float max_val = -MAXFLOAT;
                     max_index = post_process(postprocess, post_out, _attr.tokens_embed_num, token_ids, &max_val);
                 }
@@ -649,11 +2652,7 @@ public:
                 {
                     if (cached_token.size() && _attr.runing_callback)
                     {
-                        float t_cost_ms = t_cost.cost();
-                        float token_per_sec = token_ids.size() / (t_cost_ms / 1000);
-                        auto tmp_out = tokenizer->Decode(cached_token);
-                        _attr.runing_callback(cached_token.data(), cached_token.size(), tmp_out.c_str(), token_per_sec, _attr.reserve);
-                        cached_token.clear();
+                        flush_cached_token();
                     }
                     b_hit_eos = true;
                     break;
@@ -665,11 +2664,8 @@ public:
                     cached_token.push_back(max_index);
                     if (cached_token.size() >= 3)
                     {
-                        float t_cost_ms = t_cost.cost();
-                        float token_per_sec = token_ids.size() / (t_cost_ms / 1000);
-                        auto tmp_out = tokenizer->Decode(cached_token);
-                        _attr.runing_callback(cached_token.data(), cached_token.size(), tmp_out.c_str(), token_per_sec, _attr.reserve);
-                        cached_token.clear();
+                        // 在下一个 token 第一层推理期间回调，tokenizer decode 与 npu 并行
+                        b_cached_token_ready = true;
                     }
                 }
             }
@@ -681,10 +2677,23 @@ public:
                 break;
             }
         }
+        if (b_cached_token_ready)
+        {
+            flush_cached_token();
+        }
+        pending_token = next_token;
+        session_tokens.insert(session_tokens.end(), token_ids.begin(), token_ids.end());
         printf("\n\n");
         fflush(stdout);
         float t_cost_ms = t_cost.cost();
         ALOGN("hit eos,avg %.2f token/s\n", token_ids.size() / (t_cost_ms / 1000));
+        report_cache_stats("decode", decode_steps);
+        if (_attr.b_dynamic_load_axmodel_layer)
+        {
+            auto stats = layer_loader.GetStats();
+            ALOGI("layer loader: resident %d/%d, hit %d, miss %d, wait %.2f ms, load %d, unload %d", layer_loader.ResidentNum(), _attr.axmodel_num,
+                  stats.hits, stats.misses, stats.wait_ms, stats.loads, stats.unloads);
+        }
 
         // 去掉 len_of_input 那部分
         // token_ids.erase(token_ids.begin(), token_ids.begin() + len_of_input);
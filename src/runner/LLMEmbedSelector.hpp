@@ -11,12 +11,14 @@
 class LLaMaEmbedSelector
 {
     MMap _embed_map;
+    const unsigned short *_embed_ptr = nullptr; // use_mmap 时指向映射的内存
     std::vector<unsigned short> _embeds;
     unsigned int _token_num, _embed_size;
     bool _use_mmap = false;
 
 public:
-    bool Init(std::string embed_path, unsigned int token_num, unsigned int embed_size, bool use_mmap = false)
+    // 按 token 随机访问，mmap 时默认 MADV_RANDOM，不做多余的预读
+    bool Init(std::string embed_path, unsigned int token_num, unsigned int embed_size, bool use_mmap = false, MMap::option_t mmap_opt = MMap::option_t())
     {
         _token_num = token_num;
         _embed_size = embed_size;
@@ -24,11 +26,21 @@ public:
         if (use_mmap)
         {
             ALOGI("LLaMaEmbedSelector use mmap");
-            if (!_embed_map.open_file(embed_path.c_str()))
+            if (mmap_opt.advice == MADV_NORMAL)
+            {
+                mmap_opt.advice = MADV_RANDOM;
+            }
+            if (!_embed_map.open_file(embed_path.c_str(), mmap_opt))
             {
                 ALOGE("embed file(%s) open failed", embed_path.c_str());
                 return false;
             }
+            if (_embed_map.size() != (size_t)token_num * embed_size * 2)
+            {
+                ALOGE("embed file(%s) size(%ld) not equal token_num(%d) * embed_size(%d) * 2", embed_path.c_str(), (long)_embed_map.size(), token_num, embed_size);
+                return false;
+            }
+            _embed_ptr = (const unsigned short *)_embed_map.data();
         }
         else
         {
@@ -57,9 +69,39 @@ public:
         return true;
     }
 
+    // 从模型包中已经映射的内存初始化，use_mmap 时直接引用，否则拷贝一份
+    bool Init(const char *data, size_t size, unsigned int token_num, unsigned int embed_size, bool use_mmap = false)
+    {
+        _token_num = token_num;
+        _embed_size = embed_size;
+        _use_mmap = use_mmap;
+        if (size != (size_t)token_num * embed_size * 2)
+        {
+            ALOGE("embed size(%ld) not equal token_num(%d) * embed_size(%d) * 2", (long)size, token_num, embed_size);
+            return false;
+        }
+        if (use_mmap)
+        {
+            _embed_ptr = (const unsigned short *)data;
+        }
+        else
+        {
+            _embeds.resize((size_t)token_num * embed_size);
+            memcpy(_embeds.data(), data, size);
+        }
+        return true;
+    }
+
+    // 单独 mmap 的 embed 文件，没有时返回 nullptr
+    MMap *GetMap()
+    {
+        return _embed_map.data() ? &_embed_map : nullptr;
+    }
+
     void Deinit()
     {
         _embed_map.close_file();
+        _embed_ptr = nullptr;
         _embeds.clear();
     }
 
@@ -73,8 +115,7 @@ public:
         embed.resize(_embed_size);
         if (_use_mmap)
         {
-            unsigned short *ptr = (unsigned short *)_embed_map.data();
-            memcpy(embed.data(), ptr + index * _embed_size, _embed_size * sizeof(unsigned short));
+            memcpy(embed.data(), _embed_ptr + index * _embed_size, _embed_size * sizeof(unsigned short));
         }
         else
         {
@@ -92,8 +133,7 @@ public:
         
         if (_use_mmap)
         {
-            unsigned short *ptr = (unsigned short *)_embed_map.data();
-            memcpy(embed, ptr + index * _embed_size, _embed_size * sizeof(unsigned short));
+            memcpy(embed, _embed_ptr + index * _embed_size, _embed_size * sizeof(unsigned short));
         }
         else
         {
@@ -0,0 +1,279 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+
+#include "sample_log.h"
+
+// 动态加载时各层的驻留管理: 层按 0..num-1 循环使用，推理第 m 层时由加载线程提前加载 m+1..m+depth 层
+// 驻留的层占用的 cmm 不超过 budget，超出时卸载下一次使用最晚的层；当前要用的层总是会被加载
+class LLMLayerLoader
+{
+public:
+    typedef std::function<bool(int)> load_func;
+    typedef std::function<void(int)> unload_func;
+
+    struct stats_t
+    {
+        int hits = 0;   // acquire 时已经驻留
+        int misses = 0; // acquire 时需要等待加载
+        int loads = 0;
+        int unloads = 0;
+        double wait_ms = 0;
+    };
+
+private:
+    enum
+    {
+        LAYER_UNLOADED,
+        LAYER_LOADING,
+        LAYER_RESIDENT,
+        LAYER_UNLOADING,
+        LAYER_FAILED,
+    };
+
+    std::vector<int> state;
+    std::vector<size_t> cost;
+    size_t budget = 0;
+    size_t resident_bytes = 0;
+    int depth = 1;
+    int cursor = 0;          // 当前(或即将)推理的层
+    int pinned = -1;         // 正在推理的层，不能卸载
+    int blocked_cursor = -1; // 预算不够加载窗口内的层时，等 cursor 变化再重试
+    load_func load;
+    unload_func unload;
+    stats_t stats;
+
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable cond;
+    bool b_exit = false;
+    int paused = 0; // Exclusive 期间不开始新的加载/卸载
+
+    int num() { return state.size(); }
+
+    // 距离下一次使用还要经过的层数
+    int distance(int j) { return (j - cursor + num()) % num(); }
+
+    int next_load()
+    {
+        for (int i = 0; i <= depth && i < num(); i++)
+        {
+            int j = (cursor + i) % num();
+            if (state[j] == LAYER_UNLOADED)
+            {
+                return j;
+            }
+        }
+        return -1;
+    }
+
+    // 为加载 j 选择要卸载的层: -1 不需要卸载，-2 没有比 j 更晚使用的层可以卸载
+    int pick_victim(int j)
+    {
+        if (resident_bytes + cost[j] <= budget)
+        {
+            return -1;
+        }
+        int victim = -2;
+        for (int k = 0; k < num(); k++)
+        {
+            if (state[k] == LAYER_RESIDENT && k != pinned && distance(k) > distance(j) && (victim < 0 || distance(k) > distance(victim)))
+            {
+                victim = k;
+            }
+        }
+        return victim;
+    }
+
+    void loop()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        while (true)
+        {
+            int j = -1;
+            while (!b_exit && (paused > 0 || blocked_cursor == cursor || (j = next_load()) < 0))
+            {
+                cond.wait(guard);
+            }
+            if (b_exit)
+            {
+                return;
+            }
+
+            int victim = pick_victim(j);
+            if (victim == -2 && j != cursor)
+            {
+                blocked_cursor = cursor;
+                continue;
+            }
+            if (victim >= 0)
+            {
+                state[victim] = LAYER_UNLOADING;
+                guard.unlock();
+                unload(victim);
+                guard.lock();
+                state[victim] = LAYER_UNLOADED;
+                resident_bytes -= cost[victim];
+                stats.unloads++;
+                cond.notify_all();
+                continue;
+            }
+
+            state[j] = LAYER_LOADING;
+            guard.unlock();
+            bool ok = load(j);
+            guard.lock();
+            state[j] = ok ? LAYER_RESIDENT : LAYER_FAILED;
+            if (ok)
+            {
+                resident_bytes += cost[j];
+            }
+            stats.loads++;
+            cond.notify_all();
+        }
+    }
+
+public:
+    ~LLMLayerLoader() { Stop(); }
+
+    // layer_cost 为每层的 cmm 占用，budget 为 0 时只保留当前层和预取的 depth 层
+    // resident_layers 为调用者已经加载好的层，按驻留处理
+    void Start(const std::vector<size_t> &layer_cost, size_t cmm_budget, int prefetch_depth, load_func load_layer, unload_func unload_layer,
+               const std::vector<int> &resident_layers = std::vector<int>())
+    {
+        Stop();
+        cost = layer_cost;
+        state.assign(cost.size(), LAYER_UNLOADED);
+        depth = std::max(prefetch_depth, 0);
+        budget = cmm_budget;
+        if (budget == 0)
+        {
+            size_t max_cost = 0;
+            for (auto c : cost)
+            {
+                max_cost = std::max(max_cost, c);
+            }
+            budget = max_cost * (depth + 1);
+        }
+        resident_bytes = 0;
+        paused = 0;
+        for (auto m : resident_layers)
+        {
+            state[m] = LAYER_RESIDENT;
+            resident_bytes += cost[m];
+        }
+        cursor = 0;
+        pinned = -1;
+        blocked_cursor = -1;
+        load = load_layer;
+        unload = unload_layer;
+        stats = stats_t();
+        b_exit = false;
+        worker = std::thread(&LLMLayerLoader::loop, this);
+    }
+
+    // 退出加载线程，已驻留的层保持原样，由调用者释放
+    void Stop()
+    {
+        if (!worker.joinable())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            b_exit = true;
+        }
+        cond.notify_all();
+        worker.join();
+    }
+
+    bool IsRunning() { return worker.joinable(); }
+
+    // 开始预取从 m 开始的层，不等待
+    void Prefetch(int m)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        cursor = m;
+        blocked_cursor = -1;
+        cond.notify_all();
+    }
+
+    // 等待第 m 层驻留，在 Release 之前不会被卸载
+    bool Acquire(int m)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> guard(lock);
+        cursor = m;
+        pinned = m;
+        blocked_cursor = -1;
+        if (state[m] == LAYER_RESIDENT)
+        {
+            stats.hits++;
+        }
+        else
+        {
+            stats.misses++;
+            if (state[m] == LAYER_FAILED)
+            {
+                state[m] = LAYER_UNLOADED;
+            }
+            cond.notify_all();
+            cond.wait(guard, [&]
+                      { return state[m] == LAYER_RESIDENT || state[m] == LAYER_FAILED; });
+        }
+        stats.wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return state[m] == LAYER_RESIDENT;
+    }
+
+    void Release(int m)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (pinned == m)
+        {
+            pinned = -1;
+        }
+        cond.notify_all();
+    }
+
+    // 等正在进行的加载/卸载完成后，在持有锁、加载线程暂停的情况下执行 fn
+    // 加载线程在 load/unload 中对各层 runner 和 io 的修改对 fn 可见，fn 执行期间也不会有新的修改；fn 中不能再调用 loader 的接口
+    void Exclusive(const std::function<void()> &fn)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        paused++;
+        cond.wait(guard, [&]
+                  { return std::none_of(state.begin(), state.end(), [](int s)
+                                        { return s == LAYER_LOADING || s == LAYER_UNLOADING; }); });
+        fn();
+        paused--;
+        cond.notify_all();
+    }
+
+    int ResidentNum()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        int n = 0;
+        for (auto s : state)
+        {
+            n += s == LAYER_RESIDENT;
+        }
+        return n;
+    }
+
+    stats_t GetStats()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return stats;
+    }
+
+    void ResetStats()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stats = stats_t();
+    }
+};
@@ -6,6 +6,7 @@
 #include <numeric>
 #include <cmath>
 #include <unordered_set>
+#include <sstream>
 #include "utils/json.hpp"
 #include "utils/sample_log.h"
 
@@ -135,8 +136,6 @@ private:
         if (filtered_indices.empty())
             return 0;
 
-        // 使用thread_local随机数生成器（线程安全）
-        static thread_local std::mt19937 gen(std::random_device{}());
         std::discrete_distribution<int> dist(filtered_probs.begin(), filtered_probs.end());
         return filtered_indices[dist(gen)];
     }
@@ -176,8 +175,6 @@ private:
         }
 
         // Sample from the filtered distribution
-        std::random_device rd;
-        std::mt19937 gen(rd());
         std::discrete_distribution<int> dist(filtered_probs.begin(), filtered_probs.end());
         return filtered_indices[dist(gen)];
     }
@@ -210,12 +207,13 @@ private:
         }
 
         // 采样
-        std::random_device rd;
-        std::mt19937 gen(rd());
         std::discrete_distribution<int> dist(filtered_probs.begin(), filtered_probs.end());
         return filtered_indices[dist(gen)];
     }
 
+    // 所有采样共用，状态可以随会话一起保存
+    std::mt19937 gen{std::random_device{}()};
+
     bool enable_temperature = false;
     float temperature = 1.0f;
 
@@ -269,6 +267,38 @@ public:
         this->top_k = top_k;
     }
 
+    void set_seed(unsigned int seed)
+    {
+        gen.seed(seed);
+    }
+
+    // 随机数生成器的状态(文本)，用于保存和恢复会话
+    std::string get_rng_state()
+    {
+        std::ostringstream ss;
+        ss << gen;
+        return ss.str();
+    }
+
+    // 解析 get_rng_state 保存的状态，格式不对时返回 false，rng 不变
+    static bool parse_rng_state(const std::string &state, std::mt19937 &rng)
+    {
+        std::istringstream ss(state);
+        std::mt19937 tmp;
+        ss >> tmp;
+        if (ss.fail())
+        {
+            return false;
+        }
+        rng = tmp;
+        return true;
+    }
+
+    void set_rng(const std::mt19937 &rng)
+    {
+        gen = rng;
+    }
+
     bool load_config(std::string config_path)
     {
         std::ifstream config_file(config_path);
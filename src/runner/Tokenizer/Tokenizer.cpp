@@ -64,11 +64,12 @@ public:
         return true;
     }
 
-    bool Encode(std::string input, std::vector<int> &output, bool b_img_prompt = false) override
+    bool Encode(std::string input, std::vector<int> &output, bool b_img_prompt = false, bool b_continue = false) override
     {
         nlohmann::json j;
         j["text"] = input;
         j["img_prompt"] = b_img_prompt;
+        j["continue"] = b_continue;
         auto ret = cli->Post("/encode", j.dump(), "application/json");
         auto rep = ret.value();
         if (rep.status != 200)
@@ -91,7 +92,7 @@ public:
         std::vector<int> out = j2["token_ids"];
         output = out;
         // output = sp->encode(input, 1024);
-        if (_b_bos)
+        if (_b_bos && !b_continue)
         {
             output.insert(output.begin(), bos_id);
         }
@@ -103,10 +104,10 @@ public:
         return true;
     }
 
-    std::vector<int> Encode(std::string input, bool b_img_prompt = false) override
+    std::vector<int> Encode(std::string input, bool b_img_prompt = false, bool b_continue = false) override
     {
         std::vector<int> output;
-        Encode(input, output, b_img_prompt);
+        Encode(input, output, b_img_prompt, b_continue);
         return output;
     }
 
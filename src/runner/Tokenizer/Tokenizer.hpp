@@ -17,8 +17,9 @@ class BaseTokenizer
 {
 public:
     virtual bool Init(std::string model_path, bool b_bos = true, bool b_eos = false) = 0;
-    virtual bool Encode(std::string input, std::vector<int> &output, bool b_img_prompt = false) = 0;
-    virtual std::vector<int> Encode(std::string input, bool b_img_prompt = false) = 0;
+    // b_continue 为 true 时输入接在已有的会话之后，不加 bos 和 system prompt
+    virtual bool Encode(std::string input, std::vector<int> &output, bool b_img_prompt = false, bool b_continue = false) = 0;
+    virtual std::vector<int> Encode(std::string input, bool b_img_prompt = false, bool b_continue = false) = 0;
     virtual std::string Decode(const std::vector<int> input) = 0;
     virtual int GetBosID() = 0;
     virtual int GetEosID() = 0;
@@ -0,0 +1,215 @@
+#include "ax_cmm_arena.hpp"
+#include "ax_model_runner.hpp"
+#include <ax_sys_api.h>
+#include "sample_log.h"
+#include <algorithm>
+#include <iterator>
+
+#define AX_CMM_ARENA_BLOCK_ALIGN 4096
+
+static const char *AX_CMM_ARENA_TOKEN = "npu";
+
+static size_t align_up(size_t size, size_t align)
+{
+    return (size + align - 1) / align * align;
+}
+
+static int sys_alloc(unsigned long *phyAddr, void **pVirAddr, size_t size, size_t align, bool cached)
+{
+    if (cached)
+    {
+        return AX_SYS_MemAllocCached((AX_U64 *)phyAddr, pVirAddr, size, align, (const AX_S8 *)AX_CMM_ARENA_TOKEN);
+    }
+    return AX_SYS_MemAlloc((AX_U64 *)phyAddr, pVirAddr, size, align, (const AX_S8 *)AX_CMM_ARENA_TOKEN);
+}
+
+ax_cmm_arena &ax_cmm_arena::get()
+{
+    static ax_cmm_arena arena;
+    return arena;
+}
+
+void ax_cmm_arena::set_block_size(size_t size)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    block_size = align_up(size, AX_CMM_ARENA_BLOCK_ALIGN);
+}
+
+ax_cmm_arena::block_t *ax_cmm_arena::new_block(size_t size, bool cached)
+{
+    block_t *block = new block_t;
+    block->size = align_up(size, AX_CMM_ARENA_BLOCK_ALIGN);
+    block->used = 0;
+    block->cached = cached;
+    void *vir = nullptr;
+    if (sys_alloc(&block->phyAddr, &vir, block->size, AX_CMM_ARENA_BLOCK_ALIGN, cached) != 0)
+    {
+        ALOGE("alloc cmm block of %.2f MB failed", block->size / 1024.0 / 1024.0);
+        delete block;
+        return nullptr;
+    }
+    sys_alloc_count++;
+    block->pVirAddr = (char *)vir;
+    block->free_list[0] = block->size;
+    blocks.push_back(block);
+    block_index[block->phyAddr] = block;
+    return block;
+}
+
+// first fit，空闲区间按 offset 排序
+bool ax_cmm_arena::alloc_from(block_t *block, size_t size, size_t &offset)
+{
+    for (auto it = block->free_list.begin(); it != block->free_list.end(); ++it)
+    {
+        if (it->second < size)
+        {
+            continue;
+        }
+        offset = it->first;
+        size_t remain = it->second - size;
+        block->free_list.erase(it);
+        if (remain > 0)
+        {
+            block->free_list[offset + size] = remain;
+        }
+        block->used_list[offset] = size;
+        block->used += size;
+        return true;
+    }
+    return false;
+}
+
+int ax_cmm_arena::alloc(unsigned long *phyAddr, void **pVirAddr, size_t size, bool cached)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (block_size == 0)
+    {
+        int ret = sys_alloc(phyAddr, pVirAddr, size, AX_RUNNER_IO_ALIGN_SIZE, cached);
+        if (ret == 0)
+        {
+            sys_alloc_count++;
+            alloc_count++;
+        }
+        return ret;
+    }
+
+    size = align_up(size == 0 ? 1 : size, AX_RUNNER_IO_ALIGN_SIZE);
+    size_t offset = 0;
+    block_t *target = nullptr;
+    for (auto block : blocks)
+    {
+        if (block->cached == cached && alloc_from(block, size, offset))
+        {
+            target = block;
+            break;
+        }
+    }
+    if (!target)
+    {
+        // 超过 block_size 的 tensor 单独占一个 block
+        target = new_block(std::max(size, block_size), cached);
+        if (!target || !alloc_from(target, size, offset))
+        {
+            return -1;
+        }
+    }
+
+    *phyAddr = target->phyAddr + offset;
+    *pVirAddr = target->pVirAddr + offset;
+    alloc_count++;
+    used += size;
+    peak_used = std::max(peak_used, used);
+    return 0;
+}
+
+int ax_cmm_arena::free(unsigned long phyAddr, void *pVirAddr)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = block_index.upper_bound(phyAddr);
+    if (it == block_index.begin() || phyAddr >= std::prev(it)->second->phyAddr + std::prev(it)->second->size)
+    {
+        // 不在池中，是单独申请的
+        return AX_SYS_MemFree(phyAddr, pVirAddr);
+    }
+    block_t *block = std::prev(it)->second;
+    size_t offset = phyAddr - block->phyAddr;
+    auto used_it = block->used_list.find(offset);
+    if (used_it == block->used_list.end())
+    {
+        ALOGE("free unknown buffer 0x%lx", phyAddr);
+        return -1;
+    }
+    size_t size = used_it->second;
+    block->used_list.erase(used_it);
+    block->used -= size;
+    used -= size;
+
+    // 与前后的空闲区间合并
+    auto next = block->free_list.lower_bound(offset);
+    if (next != block->free_list.end() && offset + size == next->first)
+    {
+        size += next->second;
+        next = block->free_list.erase(next);
+    }
+    if (next != block->free_list.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+            prev->second += size;
+            return 0;
+        }
+    }
+    block->free_list[offset] = size;
+    return 0;
+}
+
+void ax_cmm_arena::trim()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto it = blocks.begin(); it != blocks.end();)
+    {
+        block_t *block = *it;
+        if (block->used != 0)
+        {
+            ++it;
+            continue;
+        }
+        AX_SYS_MemFree(block->phyAddr, block->pVirAddr);
+        block_index.erase(block->phyAddr);
+        delete block;
+        it = blocks.erase(it);
+    }
+}
+
+void ax_cmm_arena::print_summary()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (block_size == 0)
+    {
+        ALOGI("cmm arena disabled, %d buffers in %d cmm allocs", (int)alloc_count, (int)sys_alloc_count);
+        return;
+    }
+    size_t reserved = 0, free_size = 0, largest_free = 0, scattered = 0;
+    int cached_num = 0;
+    for (auto block : blocks)
+    {
+        reserved += block->size;
+        cached_num += block->cached;
+        size_t block_free = 0, block_largest = 0;
+        for (auto &it : block->free_list)
+        {
+            block_free += it.second;
+            block_largest = std::max(block_largest, it.second);
+        }
+        free_size += block_free;
+        largest_free = std::max(largest_free, block_largest);
+        scattered += block_free - block_largest;
+    }
+    // 空闲空间中不在各 block 最大连续区间里的比例
+    float fragmentation = free_size ? 100.f * scattered / free_size : 0.f;
+    ALOGI("cmm arena: %d blocks (%d cached), reserved %.2f MB, used %.2f MB, peak %.2f MB",
+          (int)blocks.size(), cached_num, reserved / 1024.0 / 1024.0, used / 1024.0 / 1024.0, peak_used / 1024.0 / 1024.0);
+    ALOGI("cmm arena: %d buffers in %d cmm allocs, largest free %.2f MB, fragmentation %.1f%%",
+          (int)alloc_count, (int)sys_alloc_count, largest_free / 1024.0 / 1024.0, fragmentation);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <vector>
+
+// io buffer 的 CMM 池: 一次申请大块 CMM，按 AX_RUNNER_IO_ALIGN_SIZE 对齐切分给各个 tensor
+// cached/uncached 分开管理，释放的空间合并后复用，release 之后的空块由 trim 还给系统
+class ax_cmm_arena
+{
+    struct block_t
+    {
+        unsigned long phyAddr;
+        char *pVirAddr;
+        size_t size;
+        size_t used;
+        bool cached;
+        std::map<size_t, size_t> free_list; // offset -> size
+        std::map<size_t, size_t> used_list; // offset -> size
+    };
+
+    std::mutex lock;
+    std::vector<block_t *> blocks;
+    std::map<unsigned long, block_t *> block_index; // 起始物理地址 -> block
+    size_t block_size = 16 << 20;
+
+    // 统计
+    size_t sys_alloc_count = 0;
+    size_t alloc_count = 0;
+    size_t used = 0;
+    size_t peak_used = 0;
+
+    block_t *new_block(size_t size, bool cached);
+    static bool alloc_from(block_t *block, size_t size, size_t &offset);
+
+public:
+    static ax_cmm_arena &get();
+    ~ax_cmm_arena() { trim(); }
+
+    // 0 表示不使用池，每个 buffer 单独申请 CMM
+    void set_block_size(size_t size);
+    size_t get_block_size() { return block_size; }
+
+    int alloc(unsigned long *phyAddr, void **pVirAddr, size_t size, bool cached);
+    int free(unsigned long phyAddr, void *pVirAddr);
+
+    // 把完全空闲的 block 还给系统
+    void trim();
+    void print_summary();
+};
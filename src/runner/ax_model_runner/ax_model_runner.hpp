@@ -2,7 +2,16 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <set>
 #include <stdexcept>
+#include <deque>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstdlib>
 
 typedef enum _color_space_e
 {
@@ -27,6 +36,9 @@ typedef struct _image_t
     };
 } ax_image_t;
 
+// npu io 地址的对齐要求
+#define AX_RUNNER_IO_ALIGN_SIZE 128
+
 typedef struct
 {
     std::string sName;
@@ -35,8 +47,94 @@ typedef struct
     int nSize;
     unsigned long phyAddr;
     void *pVirAddr;
+    bool bCached; // cached 内存需要 cache_flush/cache_invalidate，其它情况下这两个接口什么都不做
 } ax_runner_tensor_t;
 
+// io 的分配方式，在 init 之前通过 set_alloc_policy 按 tensor 名字指定
+typedef enum
+{
+    AX_RUNNER_ALLOC_DEFAULT = 0, // 后端默认，ax650: 输入 uncached，输出 cached
+    AX_RUNNER_ALLOC_CACHED,      // cached，cpu 写入后 flush，读取前 invalidate
+    AX_RUNNER_ALLOC_UNCACHED,    // uncached(write-combine)，无需 cache 维护，cpu 读取较慢
+    AX_RUNNER_ALLOC_SHARED,      // 不分配，推理前必须通过 set_input_buffer/set_output_buffer 绑定到其它 tensor
+} ax_runner_alloc_policy_e;
+
+// cache 维护按 cache line 对齐
+#define AX_RUNNER_CACHE_LINE_SIZE 64
+
+// 每个 tensor 的 cache 维护统计，按 tensor 名字累计
+typedef struct
+{
+    unsigned long long invalidate_count;
+    unsigned long long invalidate_bytes;
+    unsigned long long flush_count;
+    unsigned long long flush_bytes;
+} ax_runner_cache_stat_t;
+
+// 异步推理的工作线程，sdk 没有异步接口时由它串行执行 inference
+// 所有 runner 共用一个线程，npu 上的执行顺序与 submit 的顺序一致
+class ax_runner_executor
+{
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<std::function<void()>> tasks;
+    bool b_exit = false;
+
+    void loop()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                cond.wait(guard, [this]
+                          { return b_exit || !tasks.empty(); });
+                if (tasks.empty())
+                {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+    static ax_runner_executor &get()
+    {
+        static ax_runner_executor executor;
+        return executor;
+    }
+
+    ~ax_runner_executor()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            b_exit = true;
+        }
+        cond.notify_one();
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+
+    void post(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!worker.joinable())
+            {
+                worker = std::thread(&ax_runner_executor::loop, this);
+            }
+            tasks.push_back(std::move(task));
+        }
+        cond.notify_one();
+    }
+};
+
 class ax_runner_base
 {
 protected:
@@ -52,12 +150,118 @@ protected:
     std::map<std::string, std::vector<ax_runner_tensor_t>> map_group_output_tensors;
     std::map<std::string, std::vector<ax_runner_tensor_t>> map_group_input_tensors;
 
+    std::string m_model_name;
+
+    std::shared_future<int> m_pending;
+
+    std::map<std::string, ax_runner_cache_stat_t> m_cache_stats;
+    std::map<std::string, ax_runner_alloc_policy_e> m_alloc_policy;
+    std::set<std::string> m_group_shared_inputs;
+
+    // host 后端: 同名的共用输入只保留最大的一份，其它 group 释放自己的 buffer 改为引用它
+    void share_host_group_inputs(std::vector<void *> &buffers)
+    {
+        for (auto &name : m_group_shared_inputs)
+        {
+            ax_runner_tensor_t *largest = nullptr;
+            for (auto &tensors : mgroup_input_tensors)
+            {
+                for (auto &t : tensors)
+                {
+                    if (t.sName == name && t.pVirAddr && (!largest || t.nSize > largest->nSize))
+                    {
+                        largest = &t;
+                    }
+                }
+            }
+            if (!largest)
+            {
+                continue;
+            }
+            for (auto &tensors : mgroup_input_tensors)
+            {
+                for (auto &t : tensors)
+                {
+                    if (&t == largest || t.sName != name || !t.pVirAddr)
+                    {
+                        continue;
+                    }
+                    auto it = std::find(buffers.begin(), buffers.end(), t.pVirAddr);
+                    if (it != buffers.end())
+                    {
+                        free(*it);
+                        buffers.erase(it);
+                    }
+                    t.pVirAddr = largest->pVirAddr;
+                    t.phyAddr = largest->phyAddr;
+                }
+            }
+        }
+    }
+
+    // 后端实际的 cache 操作，纯 host 后端无需处理
+    virtual int invalidate_range(unsigned long phyAddr, void *pVirAddr, size_t size) { return 0; }
+    virtual int flush_range(unsigned long phyAddr, void *pVirAddr, size_t size) { return 0; }
+
+    // 把 [offset, offset + size) 扩展到 cache line 边界，不超出 tensor
+    static bool align_cache_range(const ax_runner_tensor_t &tensor, size_t &offset, size_t &size)
+    {
+        if (offset >= (size_t)tensor.nSize || size == 0)
+        {
+            return false;
+        }
+        size_t end = std::min(offset + size, (size_t)tensor.nSize);
+        offset = offset / AX_RUNNER_CACHE_LINE_SIZE * AX_RUNNER_CACHE_LINE_SIZE;
+        end = std::min((end + AX_RUNNER_CACHE_LINE_SIZE - 1) / AX_RUNNER_CACHE_LINE_SIZE * AX_RUNNER_CACHE_LINE_SIZE, (size_t)tensor.nSize);
+        size = end - offset;
+        return true;
+    }
+
+    int update_tensor_buffer(std::vector<std::vector<ax_runner_tensor_t>> &group_tensors, std::vector<ax_runner_tensor_t> &tensors,
+                             std::map<std::string, ax_runner_tensor_t> &map_tensors, std::map<std::string, std::vector<ax_runner_tensor_t>> &map_group_tensors,
+                             int grpid, int idx, const ax_runner_tensor_t &buffer, size_t offset)
+    {
+        if (grpid < 0 || grpid >= (int)group_tensors.size() || idx < 0 || idx >= (int)group_tensors[grpid].size())
+        {
+            return -1;
+        }
+        auto &tensor = group_tensors[grpid][idx];
+        if ((buffer.phyAddr + offset) % AX_RUNNER_IO_ALIGN_SIZE != 0 || buffer.pVirAddr == nullptr || offset + tensor.nSize > (size_t)buffer.nSize)
+        {
+            return -1;
+        }
+        tensor.phyAddr = buffer.phyAddr + offset;
+        tensor.pVirAddr = (char *)buffer.pVirAddr + offset;
+        tensor.bCached = buffer.bCached;
+        // 已经建立的名字索引保存的是拷贝，同步更新
+        auto it = map_group_tensors.find(tensor.sName);
+        if (it != map_group_tensors.end() && grpid < (int)it->second.size())
+        {
+            it->second[grpid] = tensor;
+        }
+        if (grpid == 0 && idx < (int)tensors.size())
+        {
+            tensors[idx] = tensor;
+            auto it0 = map_tensors.find(tensor.sName);
+            if (it0 != map_tensors.end())
+            {
+                it0->second = tensor;
+            }
+        }
+        return 0;
+    }
+
 public:
     virtual int init(const char *model_file, bool use_mmap = false) = 0;
     virtual int init(char *model_buffer, size_t model_size) = 0;
 
     virtual void deinit() = 0;
 
+    // 模型名，init(model_file) 时默认为文件路径，用于 trace 录制/回放
+    void set_model_name(const std::string &name) { m_model_name = name; }
+    const std::string &get_model_name() { return m_model_name; }
+
+    int get_num_groups() { return mgroup_input_tensors.size(); };
     int get_num_inputs() { return minput_tensors.size(); };
     int get_num_outputs() { return moutput_tensors.size(); };
 
@@ -102,6 +306,40 @@ public:
         // return map_input_tensors[name];
     }
 
+    // 在 init 之后预先解析 tensor，返回的指针在 release 之前一直有效，推理时直接使用，避免按名字查表
+    // 不存在时返回 nullptr
+    const ax_runner_tensor_t *find_input(int grpid, const std::string &name)
+    {
+        if (grpid < 0 || grpid >= (int)mgroup_input_tensors.size())
+        {
+            return nullptr;
+        }
+        for (auto &tensor : mgroup_input_tensors[grpid])
+        {
+            if (tensor.sName == name)
+            {
+                return &tensor;
+            }
+        }
+        return nullptr;
+    }
+
+    const ax_runner_tensor_t *find_output(int grpid, const std::string &name)
+    {
+        if (grpid < 0 || grpid >= (int)mgroup_output_tensors.size())
+        {
+            return nullptr;
+        }
+        for (auto &tensor : mgroup_output_tensors[grpid])
+        {
+            if (tensor.sName == name)
+            {
+                return &tensor;
+            }
+        }
+        return nullptr;
+    }
+
     const ax_runner_tensor_t &get_output(int idx) { return moutput_tensors[idx]; }
     const ax_runner_tensor_t *get_outputs_ptr() { return moutput_tensors.data(); }
     const ax_runner_tensor_t &get_output(std::string name)
@@ -145,6 +383,87 @@ public:
     virtual int inference() = 0;
     virtual int inference(int grpid) = 0;
 
+    // 把 io 换成 buffer(通常是另一个 tensor)中从 offset 开始的一段，npu 直接读写，省去 cpu 拷贝
+    // 地址需按 AX_RUNNER_IO_ALIGN_SIZE 对齐，生命周期由调用者保证，release 时不释放
+    // 已通过 find_input/find_output 解析的指针仍然有效，并指向新的 buffer
+    virtual int set_input_buffer(int grpid, int idx, const ax_runner_tensor_t &buffer, size_t offset = 0)
+    {
+        return update_tensor_buffer(mgroup_input_tensors, minput_tensors, map_input_tensors, map_group_input_tensors, grpid, idx, buffer, offset);
+    }
+
+    virtual int set_output_buffer(int grpid, int idx, const ax_runner_tensor_t &buffer, size_t offset = 0)
+    {
+        return update_tensor_buffer(mgroup_output_tensors, moutput_tensors, map_output_tensors, map_group_output_tensors, grpid, idx, buffer, offset);
+    }
+
+    // 按 tensor 名字指定 io 的分配方式，对所有 group 生效，需要在 init 之前设置
+    void set_alloc_policy(const std::map<std::string, ax_runner_alloc_policy_e> &policy) { m_alloc_policy = policy; }
+    ax_runner_alloc_policy_e get_alloc_policy(const std::string &name)
+    {
+        auto it = m_alloc_policy.find(name);
+        return it == m_alloc_policy.end() ? AX_RUNNER_ALLOC_DEFAULT : it->second;
+    }
+
+    // 按名字指定在各 group 之间共用一份 buffer 的输入(例如 LLM 的 K_cache/V_cache)，需要在 init 之前设置
+    // 同名输入按所有 group 中最大的大小分配，较小的 group 使用开头部分，所以只适用于各 group 内容一致的状态
+    void set_group_shared_inputs(const std::set<std::string> &names) { m_group_shared_inputs = names; }
+
+    // 异步推理: submit 立即返回，wait 等待最近一次 submit 完成并返回 inference 的结果
+    // 在 wait 返回之前不能读写该 group 的 io
+    virtual std::shared_future<int> submit(int grpid)
+    {
+        auto task = std::make_shared<std::packaged_task<int()>>([this, grpid]
+                                                                { return inference(grpid); });
+        m_pending = task->get_future().share();
+        ax_runner_executor::get().post([task]
+                                       { (*task)(); });
+        return m_pending;
+    }
+
+    int wait()
+    {
+        if (!m_pending.valid())
+        {
+            return 0;
+        }
+        int ret = m_pending.get();
+        m_pending = std::shared_future<int>();
+        return ret;
+    }
+
+    // 使 npu 写入的输出对 cpu 可见，只处理实际读取的 [offset, offset + size)
+    int cache_invalidate(const ax_runner_tensor_t &tensor, size_t offset, size_t size)
+    {
+        if (!tensor.bCached || !align_cache_range(tensor, offset, size))
+        {
+            return 0;
+        }
+        auto &stat = m_cache_stats[tensor.sName];
+        stat.invalidate_count++;
+        stat.invalidate_bytes += size;
+        return invalidate_range(tensor.phyAddr + offset, (char *)tensor.pVirAddr + offset, size);
+    }
+
+    int cache_invalidate(const ax_runner_tensor_t &tensor) { return cache_invalidate(tensor, 0, tensor.nSize); }
+
+    // 使 cpu 对 cached 输入的写入对 npu 可见，只处理实际写入的 [offset, offset + size)
+    int cache_flush(const ax_runner_tensor_t &tensor, size_t offset, size_t size)
+    {
+        if (!tensor.bCached || !align_cache_range(tensor, offset, size))
+        {
+            return 0;
+        }
+        auto &stat = m_cache_stats[tensor.sName];
+        stat.flush_count++;
+        stat.flush_bytes += size;
+        return flush_range(tensor.phyAddr + offset, (char *)tensor.pVirAddr + offset, size);
+    }
+
+    int cache_flush(const ax_runner_tensor_t &tensor) { return cache_flush(tensor, 0, tensor.nSize); }
+
+    const std::map<std::string, ax_runner_cache_stat_t> &get_cache_stats() { return m_cache_stats; }
+    void reset_cache_stats() { m_cache_stats.clear(); }
+
     int operator()()
     {
         return inference();
@@ -9,10 +9,9 @@
 #include <fcntl.h>
 #include "memory_utils.hpp"
 #include "sample_log.h"
-
-#define AX_CMM_ALIGN_SIZE 128
-
-const char *AX_CMM_SESSION_NAME = "npu";
+#include "ax_model_trace.hpp"
+#include "ax_cmm_arena.hpp"
+#include <chrono>
 
 typedef enum
 {
@@ -114,32 +113,57 @@ static void print_io_info(AX_ENGINE_IO_INFO_T *io_info)
     }
 }
 
-void free_io_index(AX_ENGINE_IO_BUFFER_T *io_buf, int index)
+static void free_owned(std::vector<AX_ENGINE_IO_BUFFER_T> &owned)
 {
-    for (int i = 0; i < index; ++i)
+    for (auto &buf : owned)
     {
-        AX_ENGINE_IO_BUFFER_T *pBuf = io_buf + i;
-        AX_SYS_MemFree(pBuf->phyAddr, pBuf->pVirAddr);
+        ax_cmm_arena::get().free(buf.phyAddr, buf.pVirAddr);
     }
+    owned.clear();
+}
+
+// io 可能已经通过 set_input_buffer/set_output_buffer 换成了外部 buffer，只释放自己分配的
+void free_io(AX_ENGINE_IO_T *io, std::vector<AX_ENGINE_IO_BUFFER_T> &owned)
+{
+    free_owned(owned);
+    delete[] io->pInputs;
+    delete[] io->pOutputs;
+}
+
+// DEFAULT 时按 strategy 决定是否 cached
+static bool io_cached(ax_runner_alloc_policy_e policy, AX_ENGINE_ALLOC_BUFFER_STRATEGY_T strategy)
+{
+    return policy == AX_RUNNER_ALLOC_CACHED || (policy == AX_RUNNER_ALLOC_DEFAULT && strategy == AX_ENGINE_ABST_CACHED);
 }
 
-void free_io(AX_ENGINE_IO_T *io)
+// SHARED 的 io 不分配，地址为 0，由调用者绑定
+static int alloc_io_buffer(AX_ENGINE_IO_BUFFER_T *buffer, AX_U32 size, ax_runner_alloc_policy_e policy, AX_ENGINE_ALLOC_BUFFER_STRATEGY_T strategy)
 {
-    for (size_t j = 0; j < io->nInputSize; ++j)
+    buffer->phyAddr = 0;
+    buffer->pVirAddr = nullptr;
+    buffer->nSize = size;
+    if (policy == AX_RUNNER_ALLOC_SHARED)
     {
-        AX_ENGINE_IO_BUFFER_T *pBuf = io->pInputs + j;
-        AX_SYS_MemFree(pBuf->phyAddr, pBuf->pVirAddr);
+        return 0;
     }
-    for (size_t j = 0; j < io->nOutputSize; ++j)
+    bool cached = io_cached(policy, strategy);
+    int ret = ax_cmm_arena::get().alloc((unsigned long *)(&buffer->phyAddr), &buffer->pVirAddr, size, cached);
+    if (ret != 0)
     {
-        AX_ENGINE_IO_BUFFER_T *pBuf = io->pOutputs + j;
-        AX_SYS_MemFree(pBuf->phyAddr, pBuf->pVirAddr);
+        return ret;
     }
-    delete[] io->pInputs;
-    delete[] io->pOutputs;
+    memset(buffer->pVirAddr, 0, size);
+    if (cached)
+    {
+        // 清零产生的脏数据要先写回，否则之后可能覆盖 npu 的输出
+        AX_SYS_MflushCache(buffer->phyAddr, buffer->pVirAddr, size);
+    }
+    return 0;
 }
 
-static inline int prepare_io(AX_ENGINE_IO_INFO_T *info, AX_ENGINE_IO_T *io_data, INPUT_OUTPUT_ALLOC_STRATEGY strategy)
+// 分配成功的 buffer 记录在 owned 中，shared_inputs 中的输入只在第一次遇到时按其中记录的大小分配，之后的 group 直接引用
+static inline int prepare_io(AX_ENGINE_IO_INFO_T *info, AX_ENGINE_IO_T *io_data, INPUT_OUTPUT_ALLOC_STRATEGY strategy, ax_runner_base *runner,
+                             std::map<std::string, AX_ENGINE_IO_BUFFER_T> &shared_inputs, std::vector<AX_ENGINE_IO_BUFFER_T> &owned)
 {
     memset(io_data, 0, sizeof(*io_data));
     io_data->pInputs = new AX_ENGINE_IO_BUFFER_T[info->nInputSize];
@@ -150,22 +174,30 @@ static inline int prepare_io(AX_ENGINE_IO_INFO_T *info, AX_ENGINE_IO_T *io_data,
     {
         auto meta = info->pInputs[i];
         auto buffer = &io_data->pInputs[i];
-        if (strategy.first == AX_ENGINE_ABST_CACHED)
+        auto shared = shared_inputs.find(meta.pName);
+        if (shared != shared_inputs.end() && shared->second.pVirAddr)
         {
-            ret = AX_SYS_MemAllocCached((AX_U64 *)(&buffer->phyAddr), &buffer->pVirAddr, meta.nSize, AX_CMM_ALIGN_SIZE, (const AX_S8 *)(AX_CMM_SESSION_NAME));
+            *buffer = shared->second;
+            buffer->nSize = meta.nSize;
+            continue;
         }
-        else
-        {
-            ret = AX_SYS_MemAlloc((AX_U64 *)(&buffer->phyAddr), &buffer->pVirAddr, meta.nSize, AX_CMM_ALIGN_SIZE, (const AX_S8 *)(AX_CMM_SESSION_NAME));
-        }
-
+        AX_U32 size = shared != shared_inputs.end() ? shared->second.nSize : meta.nSize;
+        ret = alloc_io_buffer(buffer, size, runner->get_alloc_policy(meta.pName), strategy.first);
         if (ret != 0)
         {
-            free_io_index(io_data->pInputs, i);
-            fprintf(stderr, "Allocate input{%d} { phy: %p, vir: %p, size: %lu Bytes }. fail \n", i, (void *)buffer->phyAddr, buffer->pVirAddr, (long)meta.nSize);
+            free_owned(owned);
+            fprintf(stderr, "Allocate input{%d} { phy: %p, vir: %p, size: %lu Bytes }. fail \n", i, (void *)buffer->phyAddr, buffer->pVirAddr, (long)size);
             return ret;
         }
-        memset(buffer->pVirAddr, 0, meta.nSize);
+        if (buffer->pVirAddr)
+        {
+            owned.push_back(*buffer);
+        }
+        if (shared != shared_inputs.end())
+        {
+            shared->second = *buffer;
+        }
+        buffer->nSize = meta.nSize;
         // fprintf(stderr, "Allocate input{%d} { phy: %p, vir: %p, size: %lu Bytes }. \n", i, (void*)buffer->phyAddr, buffer->pVirAddr, (long)meta.nSize);
     }
 
@@ -175,23 +207,17 @@ static inline int prepare_io(AX_ENGINE_IO_INFO_T *info, AX_ENGINE_IO_T *io_data,
     {
         auto meta = info->pOutputs[i];
         auto buffer = &io_data->pOutputs[i];
-        buffer->nSize = meta.nSize;
-        if (strategy.second == AX_ENGINE_ABST_CACHED)
-        {
-            ret = AX_SYS_MemAllocCached((AX_U64 *)(&buffer->phyAddr), &buffer->pVirAddr, meta.nSize, AX_CMM_ALIGN_SIZE, (const AX_S8 *)(AX_CMM_SESSION_NAME));
-        }
-        else
-        {
-            ret = AX_SYS_MemAlloc((AX_U64 *)(&buffer->phyAddr), &buffer->pVirAddr, meta.nSize, AX_CMM_ALIGN_SIZE, (const AX_S8 *)(AX_CMM_SESSION_NAME));
-        }
+        ret = alloc_io_buffer(buffer, meta.nSize, runner->get_alloc_policy(meta.pName), strategy.second);
         if (ret != 0)
         {
             fprintf(stderr, "Allocate output{%d} { phy: %p, vir: %p, size: %lu Bytes }. fail \n", i, (void *)buffer->phyAddr, buffer->pVirAddr, (long)meta.nSize);
-            free_io_index(io_data->pInputs, io_data->nInputSize);
-            free_io_index(io_data->pOutputs, i);
+            free_owned(owned);
             return ret;
         }
-        memset(buffer->pVirAddr, 0, meta.nSize);
+        if (buffer->pVirAddr)
+        {
+            owned.push_back(*buffer);
+        }
         // fprintf(stderr, "Allocate output{%d} { phy: %p, vir: %p, size: %lu Bytes }.\n", i, (void*)buffer->phyAddr, buffer->pVirAddr, (long)meta.nSize);
     }
 
@@ -200,10 +226,11 @@ static inline int prepare_io(AX_ENGINE_IO_INFO_T *info, AX_ENGINE_IO_T *io_data,
 
 struct ax_joint_runner_ax650_handle_t
 {
-    AX_ENGINE_HANDLE handle;
-    AX_ENGINE_CONTEXT_T context;
+    AX_ENGINE_HANDLE handle = nullptr;
+    AX_ENGINE_CONTEXT_T context = nullptr;
     std::vector<AX_ENGINE_IO_INFO_T *> io_info;
     std::vector<AX_ENGINE_IO_T> io_data;
+    std::vector<std::vector<AX_ENGINE_IO_BUFFER_T>> io_owned;
 
     // int algo_width, algo_height;
     // int algo_colorformat;
@@ -238,6 +265,7 @@ int ax_runner_ax650::sub_init()
 
     m_handle->io_info.resize(io_count);
     m_handle->io_data.resize(io_count);
+    m_handle->io_owned.resize(io_count);
     mgroup_input_tensors.resize(io_count);
     mgroup_output_tensors.resize(io_count);
 
@@ -246,6 +274,7 @@ int ax_runner_ax650::sub_init()
     // 6. alloc io
     if (!_parepare_io)
     {
+        auto io_strategy = std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED);
         for (size_t grpid = 0; grpid < io_count; grpid++)
         {
             AX_ENGINE_IO_INFO_T *io_info = nullptr;
@@ -258,8 +287,27 @@ int ax_runner_ax650::sub_init()
             // print_io_info(io_info);
 
             m_handle->io_info[grpid] = io_info;
+        }
 
-            ret = prepare_io(m_handle->io_info[grpid], &m_handle->io_data[grpid], std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED));
+        // 各 group 同名的共用输入(例如 K_cache/V_cache)按最大的大小只分配一份
+        std::map<std::string, AX_ENGINE_IO_BUFFER_T> shared_inputs;
+        for (auto io_info : m_handle->io_info)
+        {
+            for (size_t i = 0; i < io_info->nInputSize; i++)
+            {
+                auto &meta = io_info->pInputs[i];
+                if (meta.nSize == 0 || !m_group_shared_inputs.count(meta.pName))
+                {
+                    continue;
+                }
+                auto &buf = shared_inputs[meta.pName];
+                buf.nSize = std::max(buf.nSize, meta.nSize);
+            }
+        }
+
+        for (size_t grpid = 0; grpid < io_count; grpid++)
+        {
+            ret = prepare_io(m_handle->io_info[grpid], &m_handle->io_data[grpid], io_strategy, this, shared_inputs, m_handle->io_owned[grpid]);
             if (0 != ret)
             {
                 ALOGE("prepare_io grpid=%d", grpid);
@@ -283,6 +331,7 @@ int ax_runner_ax650::sub_init()
                 }
                 tensor.phyAddr = io_data.pOutputs[i].phyAddr;
                 tensor.pVirAddr = io_data.pOutputs[i].pVirAddr;
+                tensor.bCached = tensor.pVirAddr && io_cached(get_alloc_policy(tensor.sName), io_strategy.second);
                 mgroup_output_tensors[grpid].push_back(tensor);
             }
 
@@ -298,6 +347,7 @@ int ax_runner_ax650::sub_init()
                 }
                 tensor.phyAddr = io_data.pInputs[i].phyAddr;
                 tensor.pVirAddr = io_data.pInputs[i].pVirAddr;
+                tensor.bCached = tensor.pVirAddr && io_cached(get_alloc_policy(tensor.sName), io_strategy.first);
                 mgroup_input_tensors[grpid].push_back(tensor);
             }
         }
@@ -316,9 +366,16 @@ int ax_runner_ax650::sub_init()
 
 int ax_runner_ax650::init(const char *model_file, bool use_mmap)
 {
+    if (m_model_name.empty())
+    {
+        m_model_name = model_file;
+    }
     if (use_mmap)
     {
-        MMap model_buffer(model_file);
+        // 模型只顺序读一遍
+        MMap::option_t opt;
+        opt.advice = MADV_SEQUENTIAL;
+        MMap model_buffer(model_file, opt);
         if (!model_buffer.data())
         {
             ALOGE("mmap");
@@ -371,6 +428,8 @@ int ax_runner_ax650::init(char *model_buffer, size_t model_size)
     int ret = AX_ENGINE_CreateHandle(&m_handle->handle, model_buffer, model_size);
     if (0 != ret)
     {
+        // 动态加载时 init 失败后仍会 release，不能留下无效的 handle
+        m_handle->handle = nullptr;
         ALOGE("AX_ENGINE_CreateHandle");
         return ret;
     }
@@ -381,14 +440,17 @@ int ax_runner_ax650::init(char *model_buffer, size_t model_size)
 
 void ax_runner_ax650::release()
 {
-    if (m_handle && m_handle->handle)
+    if (m_handle && _parepare_io)
     {
         for (size_t i = 0; i < m_handle->io_data.size(); i++)
         {
-            /* code */
-            free_io(&m_handle->io_data[i]);
+            free_io(&m_handle->io_data[i], m_handle->io_owned[i]);
         }
+        _parepare_io = false;
+    }
 
+    if (m_handle && m_handle->handle)
+    {
         AX_ENGINE_DestroyHandle(m_handle->handle);
         m_handle->handle = nullptr;
     }
@@ -430,12 +492,86 @@ void ax_runner_ax650::deinit()
     // AX_ENGINE_Deinit();
 }
 
+int ax_runner_ax650::record(int grpid, int ret, double cost_us, const std::vector<unsigned long long> &input_hashes)
+{
+    auto &trace = ax_model_trace::get();
+    if (ret != 0)
+    {
+        return ret;
+    }
+    if (_trace_model_id < 0)
+    {
+        _trace_model_id = trace.register_model(m_model_name, mgroup_input_tensors, mgroup_output_tensors);
+    }
+    for (auto &tensor : mgroup_output_tensors[grpid])
+    {
+        // 录制不计入 cache 统计
+        if (tensor.bCached)
+        {
+            invalidate_range(tensor.phyAddr, tensor.pVirAddr, tensor.nSize);
+        }
+    }
+    trace.record(_trace_model_id, grpid, input_hashes, mgroup_output_tensors[grpid], (unsigned int)cost_us);
+    return ret;
+}
+
 int ax_runner_ax650::inference()
 {
-    return AX_ENGINE_RunSync(m_handle->handle, &m_handle->io_data[0]);
+    if (!ax_model_trace::get().recording())
+    {
+        return AX_ENGINE_RunSync(m_handle->handle, &m_handle->io_data[0]);
+    }
+    auto hashes = ax_model_trace::hash_inputs(mgroup_input_tensors[0]);
+    auto start = std::chrono::steady_clock::now();
+    int ret = AX_ENGINE_RunSync(m_handle->handle, &m_handle->io_data[0]);
+    return record(0, ret, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count(), hashes);
 }
 
 int ax_runner_ax650::inference(int grpid)
 {
-    return AX_ENGINE_RunGroupIOSync(m_handle->handle, m_handle->context, grpid, &m_handle->io_data[grpid]);
-}
\ No newline at end of file
+    if (!ax_model_trace::get().recording())
+    {
+        return AX_ENGINE_RunGroupIOSync(m_handle->handle, m_handle->context, grpid, &m_handle->io_data[grpid]);
+    }
+    // 输出可能写入输入的 buffer，hash 在推理前计算
+    auto hashes = ax_model_trace::hash_inputs(mgroup_input_tensors[grpid]);
+    auto start = std::chrono::steady_clock::now();
+    int ret = AX_ENGINE_RunGroupIOSync(m_handle->handle, m_handle->context, grpid, &m_handle->io_data[grpid]);
+    return record(grpid, ret, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count(), hashes);
+}
+
+int ax_runner_ax650::invalidate_range(unsigned long phyAddr, void *pVirAddr, size_t size)
+{
+    return AX_SYS_MinvalidateCache(phyAddr, pVirAddr, size);
+}
+
+int ax_runner_ax650::flush_range(unsigned long phyAddr, void *pVirAddr, size_t size)
+{
+    return AX_SYS_MflushCache(phyAddr, pVirAddr, size);
+}
+
+int ax_runner_ax650::set_input_buffer(int grpid, int idx, const ax_runner_tensor_t &buffer, size_t offset)
+{
+    int ret = ax_runner_base::set_input_buffer(grpid, idx, buffer, offset);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    auto &buf = m_handle->io_data[grpid].pInputs[idx];
+    buf.phyAddr = mgroup_input_tensors[grpid][idx].phyAddr;
+    buf.pVirAddr = mgroup_input_tensors[grpid][idx].pVirAddr;
+    return 0;
+}
+
+int ax_runner_ax650::set_output_buffer(int grpid, int idx, const ax_runner_tensor_t &buffer, size_t offset)
+{
+    int ret = ax_runner_base::set_output_buffer(grpid, idx, buffer, offset);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    auto &buf = m_handle->io_data[grpid].pOutputs[idx];
+    buf.phyAddr = mgroup_output_tensors[grpid][idx].phyAddr;
+    buf.pVirAddr = mgroup_output_tensors[grpid][idx].pVirAddr;
+    return 0;
+}
@@ -7,8 +7,13 @@ protected:
     struct ax_joint_runner_ax650_handle_t *m_handle = nullptr;
 
     bool _parepare_io = false;
+    int _trace_model_id = -1;
 
     int sub_init();
+    int record(int grpid, int ret, double cost_us, const std::vector<unsigned long long> &input_hashes);
+
+    int invalidate_range(unsigned long phyAddr, void *pVirAddr, size_t size) override;
+    int flush_range(unsigned long phyAddr, void *pVirAddr, size_t size) override;
 
 public:
     int init(const char *model_file, bool use_mmap = false) override;
@@ -19,4 +24,7 @@ public:
 
     int inference() override;
     int inference(int grpid) override;
+
+    int set_input_buffer(int grpid, int idx, const ax_runner_tensor_t &buffer, size_t offset = 0) override;
+    int set_output_buffer(int grpid, int idx, const ax_runner_tensor_t &buffer, size_t offset = 0) override;
 };
\ No newline at end of file
@@ -0,0 +1,713 @@
+#include "ax_model_runner_cpu.hpp"
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <memory>
+#include "memory_utils.hpp"
+#include "sample_log.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#define AX_CPU_ALIGN_SIZE 128
+// mask 中小于该值的位置视为不参与 attention
+#define AX_CPU_MASK_THRESHOLD -10000.f
+
+static inline float bf16_to_fp32(unsigned short v)
+{
+    unsigned int proc = (unsigned int)v << 16;
+    float f;
+    memcpy(&f, &proc, sizeof(f));
+    return f;
+}
+
+static inline unsigned short fp32_to_bf16(float f)
+{
+    unsigned int u;
+    memcpy(&u, &f, sizeof(u));
+    if ((u & 0x7fffffff) > 0x7f800000)
+    {
+        return (unsigned short)((u >> 16) | 0x40);
+    }
+    // round to nearest even
+    u += 0x7fff + ((u >> 16) & 1);
+    return (unsigned short)(u >> 16);
+}
+
+static inline float dot_bf16_f32(const unsigned short *w, const float *x, int n)
+{
+    int i = 0;
+    float sum = 0.f;
+#if defined(__AVX2__) && defined(__FMA__)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i w0 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(w + i)));
+        __m256i w1 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(w + i + 8)));
+        acc0 = _mm256_fmadd_ps(_mm256_castsi256_ps(_mm256_slli_epi32(w0, 16)), _mm256_loadu_ps(x + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_castsi256_ps(_mm256_slli_epi32(w1, 16)), _mm256_loadu_ps(x + i + 8), acc1);
+    }
+    acc0 = _mm256_add_ps(acc0, acc1);
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    s = _mm_hadd_ps(s, s);
+    s = _mm_hadd_ps(s, s);
+    sum = _mm_cvtss_f32(s);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t acc0 = vdupq_n_f32(0.f);
+    float32x4_t acc1 = vdupq_n_f32(0.f);
+    for (; i + 8 <= n; i += 8)
+    {
+        uint16x8_t v = vld1q_u16(w + i);
+        float32x4_t lo = vreinterpretq_f32_u32(vshll_n_u16(vget_low_u16(v), 16));
+        float32x4_t hi = vreinterpretq_f32_u32(vshll_high_n_u16(v, 16));
+        acc0 = vfmaq_f32(acc0, lo, vld1q_f32(x + i));
+        acc1 = vfmaq_f32(acc1, hi, vld1q_f32(x + i + 4));
+    }
+    sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+    for (; i < n; i++)
+    {
+        sum += bf16_to_fp32(w[i]) * x[i];
+    }
+    return sum;
+}
+
+static inline float dot_f32(const float *a, const float *b, int n)
+{
+    int i = 0;
+    float sum = 0.f;
+#if defined(__AVX2__) && defined(__FMA__)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    acc0 = _mm256_add_ps(acc0, acc1);
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    s = _mm_hadd_ps(s, s);
+    s = _mm_hadd_ps(s, s);
+    sum = _mm_cvtss_f32(s);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t acc0 = vdupq_n_f32(0.f);
+    float32x4_t acc1 = vdupq_n_f32(0.f);
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+    for (; i < n; i++)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// y[n, out] = x[n, in] * w[out, in]^T + b[out]
+static void matmul_bf16(const unsigned short *w, const unsigned short *b, const float *x, float *y, int n, int in, int out)
+{
+    if (n == 1)
+    {
+#pragma omp parallel for schedule(static)
+        for (int o = 0; o < out; o++)
+        {
+            y[o] = dot_bf16_f32(w + (size_t)o * in, x, in) + (b ? bf16_to_fp32(b[o]) : 0.f);
+        }
+        return;
+    }
+
+    // 每行权重只解码一次，在 n 个 token 间复用
+#pragma omp parallel
+    {
+        std::vector<float> row(in);
+#pragma omp for schedule(static)
+        for (int o = 0; o < out; o++)
+        {
+            const unsigned short *wr = w + (size_t)o * in;
+            for (int k = 0; k < in; k++)
+            {
+                row[k] = bf16_to_fp32(wr[k]);
+            }
+            float bias = b ? bf16_to_fp32(b[o]) : 0.f;
+            for (int t = 0; t < n; t++)
+            {
+                y[(size_t)t * out + o] = dot_f32(row.data(), x + (size_t)t * in, in) + bias;
+            }
+        }
+    }
+}
+
+static void rms_norm(const float *x, const unsigned short *w, float *y, int n, int size, float eps)
+{
+    for (int t = 0; t < n; t++)
+    {
+        const float *xr = x + (size_t)t * size;
+        float *yr = y + (size_t)t * size;
+        float ss = dot_f32(xr, xr, size);
+        float scale = 1.f / sqrtf(ss / size + eps);
+        for (int k = 0; k < size; k++)
+        {
+            yr[k] = xr[k] * scale * bf16_to_fp32(w[k]);
+        }
+    }
+}
+
+static void apply_rope(float *x, int heads, int head_dim, unsigned int pos, float theta)
+{
+    int half = head_dim / 2;
+    for (int d = 0; d < half; d++)
+    {
+        float freq = powf(theta, -2.f * d / head_dim);
+        float angle = pos * freq;
+        float c = cosf(angle), s = sinf(angle);
+        for (int h = 0; h < heads; h++)
+        {
+            float *xh = x + h * head_dim;
+            float x1 = xh[d], x2 = xh[d + half];
+            xh[d] = x1 * c - x2 * s;
+            xh[d + half] = x2 * c + x1 * s;
+        }
+    }
+}
+
+struct ax_cpu_runner_handle_t
+{
+    ax_cpu_model_header_t header;
+    std::vector<unsigned short> weights;
+
+    const unsigned short *input_norm = nullptr;
+    const unsigned short *q_w = nullptr, *q_b = nullptr;
+    const unsigned short *k_w = nullptr, *k_b = nullptr;
+    const unsigned short *v_w = nullptr, *v_b = nullptr;
+    const unsigned short *o_w = nullptr;
+    const unsigned short *post_norm = nullptr;
+    const unsigned short *gate_w = nullptr, *up_w = nullptr, *down_w = nullptr;
+
+    const unsigned short *norm = nullptr;
+    const unsigned short *lm_head = nullptr;
+
+    std::vector<void *> io_buffers;
+
+    std::vector<float> x, xn, q, k, v, attn, mlp_gate, mlp_up, tmp;
+};
+
+static void *alloc_io(std::vector<void *> &buffers, size_t size)
+{
+    if (size == 0)
+    {
+        return nullptr;
+    }
+    size_t aligned = (size + AX_CPU_ALIGN_SIZE - 1) / AX_CPU_ALIGN_SIZE * AX_CPU_ALIGN_SIZE;
+    void *ptr = aligned_alloc(AX_CPU_ALIGN_SIZE, aligned);
+    if (ptr)
+    {
+        memset(ptr, 0, aligned);
+        buffers.push_back(ptr);
+    }
+    return ptr;
+}
+
+// host 内存不区分 cached/uncached，SHARED 的 io 不分配
+static void add_tensor(std::vector<ax_runner_tensor_t> &tensors, std::vector<void *> &buffers, const std::map<std::string, ax_runner_alloc_policy_e> &policy,
+                       const char *name, std::vector<unsigned int> shape, int elem_size)
+{
+    ax_runner_tensor_t tensor;
+    tensor.nIdx = tensors.size();
+    tensor.sName = name;
+    tensor.vShape = shape;
+    size_t size = elem_size;
+    for (auto s : shape)
+    {
+        size *= s;
+    }
+    tensor.nSize = size;
+    auto it = policy.find(name);
+    tensor.pVirAddr = it != policy.end() && it->second == AX_RUNNER_ALLOC_SHARED ? nullptr : alloc_io(buffers, size);
+    tensor.phyAddr = (unsigned long)tensor.pVirAddr;
+    tensor.bCached = false;
+    tensors.push_back(tensor);
+}
+
+int ax_runner_cpu::sub_init()
+{
+    auto &hdr = m_handle->header;
+    if (_parepare_io)
+    {
+        return 0;
+    }
+
+    unsigned int kv_size = hdr.num_kv_heads * hdr.head_dim;
+    if (hdr.type == AX_CPU_MODEL_LAYER)
+    {
+        int group_num = 1 + hdr.prefill_group_num;
+        mgroup_input_tensors.resize(group_num);
+        mgroup_output_tensors.resize(group_num);
+        for (int grpid = 0; grpid < group_num; grpid++)
+        {
+            unsigned int token_num = grpid == 0 ? 1 : hdr.prefill_token_num[grpid - 1];
+            unsigned int history = grpid == 0 ? hdr.kv_cache_num : hdr.prefill_kv_cache_num[grpid - 1];
+
+            auto &inputs = mgroup_input_tensors[grpid];
+            add_tensor(inputs, m_handle->io_buffers, m_alloc_policy, "indices", {1, token_num}, sizeof(unsigned int));
+            add_tensor(inputs, m_handle->io_buffers, m_alloc_policy, "K_cache", {1, history, kv_size}, sizeof(unsigned short));
+            add_tensor(inputs, m_handle->io_buffers, m_alloc_policy, "V_cache", {1, history, kv_size}, sizeof(unsigned short));
+            add_tensor(inputs, m_handle->io_buffers, m_alloc_policy, "input", {1, token_num, hdr.hidden_size}, sizeof(unsigned short));
+            add_tensor(inputs, m_handle->io_buffers, m_alloc_policy, "mask", {1, token_num, history + token_num}, sizeof(unsigned short));
+
+            auto &outputs = mgroup_output_tensors[grpid];
+            add_tensor(outputs, m_handle->io_buffers, m_alloc_policy, "K_cache_out", {1, token_num, kv_size}, sizeof(unsigned short));
+            add_tensor(outputs, m_handle->io_buffers, m_alloc_policy, "V_cache_out", {1, token_num, kv_size}, sizeof(unsigned short));
+            add_tensor(outputs, m_handle->io_buffers, m_alloc_policy, "output", {1, token_num, hdr.hidden_size}, sizeof(unsigned short));
+        }
+    }
+    else
+    {
+        mgroup_input_tensors.resize(1);
+        mgroup_output_tensors.resize(1);
+        add_tensor(mgroup_input_tensors[0], m_handle->io_buffers, m_alloc_policy, "input", {1, 1, hdr.hidden_size}, sizeof(unsigned short));
+        add_tensor(mgroup_output_tensors[0], m_handle->io_buffers, m_alloc_policy, "output", {1, 1, hdr.vocab_size}, sizeof(unsigned short));
+        add_tensor(mgroup_output_tensors[0], m_handle->io_buffers, m_alloc_policy, "indices", {1, 1}, sizeof(int));
+    }
+
+    for (auto &tensors : mgroup_input_tensors)
+    {
+        for (auto &t : tensors)
+        {
+            if (t.nSize && !t.pVirAddr && get_alloc_policy(t.sName) != AX_RUNNER_ALLOC_SHARED)
+            {
+                ALOGE("alloc input %s failed", t.sName.c_str());
+                return -1;
+            }
+        }
+    }
+    for (auto &tensors : mgroup_output_tensors)
+    {
+        for (auto &t : tensors)
+        {
+            if (t.nSize && !t.pVirAddr && get_alloc_policy(t.sName) != AX_RUNNER_ALLOC_SHARED)
+            {
+                ALOGE("alloc output %s failed", t.sName.c_str());
+                return -1;
+            }
+        }
+    }
+
+    share_host_group_inputs(m_handle->io_buffers);
+
+    moutput_tensors = mgroup_output_tensors[0];
+    minput_tensors = mgroup_input_tensors[0];
+
+    _parepare_io = true;
+    return 0;
+}
+
+int ax_runner_cpu::init(const char *model_file, bool use_mmap)
+{
+    if (use_mmap)
+    {
+        // 模型只顺序读一遍
+        MMap::option_t opt;
+        opt.advice = MADV_SEQUENTIAL;
+        MMap model_buffer(model_file, opt);
+        if (!model_buffer.data())
+        {
+            ALOGE("mmap");
+            return -1;
+        }
+        auto ret = init((char *)model_buffer.data(), model_buffer.size());
+        model_buffer.close_file();
+        return ret;
+    }
+    else
+    {
+        char *model_buffer;
+        size_t len;
+        if (!read_file(model_file, &model_buffer, &len))
+        {
+            ALOGE("read_file");
+            return -1;
+        }
+        auto ret = init(model_buffer, len);
+        delete[] model_buffer;
+        return ret;
+    }
+}
+
+int ax_runner_cpu::init(char *model_buffer, size_t model_size)
+{
+    if (model_size < sizeof(ax_cpu_model_header_t))
+    {
+        ALOGE("model size(%ld) too small", (long)model_size);
+        return -1;
+    }
+
+    ax_cpu_model_header_t hdr;
+    memcpy(&hdr, model_buffer, sizeof(hdr));
+    if (hdr.magic != AX_CPU_MODEL_MAGIC || hdr.version != AX_CPU_MODEL_VERSION)
+    {
+        ALOGE("not a cpu model, magic(%08x) version(%d)", hdr.magic, hdr.version);
+        return -1;
+    }
+    if (hdr.prefill_group_num > AX_CPU_MODEL_MAX_GROUP || hdr.num_kv_heads == 0 || hdr.num_heads % hdr.num_kv_heads != 0)
+    {
+        ALOGE("invalid cpu model header");
+        return -1;
+    }
+
+    size_t H = hdr.hidden_size, I = hdr.intermediate_size;
+    size_t q_size = (size_t)hdr.num_heads * hdr.head_dim;
+    size_t kv_size = (size_t)hdr.num_kv_heads * hdr.head_dim;
+    bool bias = hdr.flags & AX_CPU_MODEL_FLAG_QKV_BIAS;
+    size_t weight_num = 0;
+    if (hdr.type == AX_CPU_MODEL_LAYER)
+    {
+        weight_num = H + q_size * H + kv_size * H * 2 + H * q_size + H + I * H * 2 + H * I;
+        if (bias)
+        {
+            weight_num += q_size + kv_size * 2;
+        }
+    }
+    else if (hdr.type == AX_CPU_MODEL_POST)
+    {
+        weight_num = H + (size_t)hdr.vocab_size * H;
+    }
+    else
+    {
+        ALOGE("unknown cpu model type(%d)", hdr.type);
+        return -1;
+    }
+
+    if (model_size < sizeof(hdr) + weight_num * sizeof(unsigned short))
+    {
+        ALOGE("model size(%ld) < expected(%ld)", (long)model_size, (long)(sizeof(hdr) + weight_num * sizeof(unsigned short)));
+        return -1;
+    }
+
+    if (!m_handle)
+    {
+        m_handle = new ax_cpu_runner_handle_t;
+    }
+    m_handle->header = hdr;
+    m_handle->weights.resize(weight_num);
+    memcpy(m_handle->weights.data(), model_buffer + sizeof(hdr), weight_num * sizeof(unsigned short));
+
+    const unsigned short *p = m_handle->weights.data();
+    auto take = [&p](size_t n)
+    {
+        const unsigned short *r = p;
+        p += n;
+        return r;
+    };
+    if (hdr.type == AX_CPU_MODEL_LAYER)
+    {
+        m_handle->input_norm = take(H);
+        m_handle->q_w = take(q_size * H);
+        m_handle->q_b = bias ? take(q_size) : nullptr;
+        m_handle->k_w = take(kv_size * H);
+        m_handle->k_b = bias ? take(kv_size) : nullptr;
+        m_handle->v_w = take(kv_size * H);
+        m_handle->v_b = bias ? take(kv_size) : nullptr;
+        m_handle->o_w = take(H * q_size);
+        m_handle->post_norm = take(H);
+        m_handle->gate_w = take(I * H);
+        m_handle->up_w = take(I * H);
+        m_handle->down_w = take(H * I);
+    }
+    else
+    {
+        m_handle->norm = take(H);
+        m_handle->lm_head = take((size_t)hdr.vocab_size * H);
+    }
+
+    return sub_init();
+}
+
+int ax_runner_cpu::run_layer(int grpid)
+{
+    auto &hdr = m_handle->header;
+    auto &inputs = mgroup_input_tensors[grpid];
+    auto &outputs = mgroup_output_tensors[grpid];
+
+    const ax_runner_tensor_t *t_indices = nullptr, *t_k_cache = nullptr, *t_v_cache = nullptr, *t_input = nullptr, *t_mask = nullptr;
+    for (auto &t : inputs)
+    {
+        if (t.sName == "indices")
+            t_indices = &t;
+        else if (t.sName == "K_cache")
+            t_k_cache = &t;
+        else if (t.sName == "V_cache")
+            t_v_cache = &t;
+        else if (t.sName == "input")
+            t_input = &t;
+        else if (t.sName == "mask")
+            t_mask = &t;
+    }
+    const ax_runner_tensor_t *t_k_out = nullptr, *t_v_out = nullptr, *t_output = nullptr;
+    for (auto &t : outputs)
+    {
+        if (t.sName == "K_cache_out")
+            t_k_out = &t;
+        else if (t.sName == "V_cache_out")
+            t_v_out = &t;
+        else if (t.sName == "output")
+            t_output = &t;
+    }
+    if (!t_indices || !t_k_cache || !t_v_cache || !t_input || !t_mask || !t_k_out || !t_v_out || !t_output)
+    {
+        ALOGE("grpid(%d) io incomplete", grpid);
+        return -1;
+    }
+
+    const int n = t_indices->vShape[1];
+    const int history = t_k_cache->vShape[1];
+    const int H = hdr.hidden_size, I = hdr.intermediate_size;
+    const int nh = hdr.num_heads, nkv = hdr.num_kv_heads, hd = hdr.head_dim;
+    const int q_size = nh * hd, kv_size = nkv * hd;
+    const int mask_width = history + n;
+
+    auto &x = m_handle->x;
+    auto &xn = m_handle->xn;
+    auto &q = m_handle->q;
+    auto &k = m_handle->k;
+    auto &v = m_handle->v;
+    auto &attn = m_handle->attn;
+    x.resize((size_t)n * H);
+    xn.resize((size_t)n * H);
+    q.resize((size_t)n * q_size);
+    k.resize((size_t)n * kv_size);
+    v.resize((size_t)n * kv_size);
+    attn.resize((size_t)n * q_size);
+
+    const unsigned short *input = (const unsigned short *)t_input->pVirAddr;
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        x[i] = bf16_to_fp32(input[i]);
+    }
+
+    // attention
+    rms_norm(x.data(), m_handle->input_norm, xn.data(), n, H, hdr.rms_norm_eps);
+    matmul_bf16(m_handle->q_w, m_handle->q_b, xn.data(), q.data(), n, H, q_size);
+    matmul_bf16(m_handle->k_w, m_handle->k_b, xn.data(), k.data(), n, H, kv_size);
+    matmul_bf16(m_handle->v_w, m_handle->v_b, xn.data(), v.data(), n, H, kv_size);
+
+    const unsigned int *indices = (const unsigned int *)t_indices->pVirAddr;
+    unsigned short *k_out = (unsigned short *)t_k_out->pVirAddr;
+    unsigned short *v_out = (unsigned short *)t_v_out->pVirAddr;
+    for (int t = 0; t < n; t++)
+    {
+        apply_rope(q.data() + (size_t)t * q_size, nh, hd, indices[t], hdr.rope_theta);
+        apply_rope(k.data() + (size_t)t * kv_size, nkv, hd, indices[t], hdr.rope_theta);
+    }
+    for (size_t i = 0; i < k.size(); i++)
+    {
+        k_out[i] = fp32_to_bf16(k[i]);
+        v_out[i] = fp32_to_bf16(v[i]);
+    }
+
+    const unsigned short *k_cache = (const unsigned short *)t_k_cache->pVirAddr;
+    const unsigned short *v_cache = (const unsigned short *)t_v_cache->pVirAddr;
+    const unsigned short *mask = (const unsigned short *)t_mask->pVirAddr;
+    const float scale = 1.f / sqrtf((float)hd);
+    const int group = nh / nkv;
+
+#pragma omp parallel
+    {
+        std::vector<float> scores(mask_width);
+        std::vector<int> cols(mask_width);
+        std::vector<float> qh(hd);
+#pragma omp for schedule(static)
+        for (int th = 0; th < n * nh; th++)
+        {
+            int t = th / nh, h = th % nh;
+            int kvh = h / group;
+            memcpy(qh.data(), q.data() + (size_t)t * q_size + h * hd, hd * sizeof(float));
+            const unsigned short *mrow = mask + (size_t)t * mask_width;
+
+            // 只计算未被 mask 的位置
+            int cnt = 0;
+            float max_score = -INFINITY;
+            for (int j = 0; j < mask_width; j++)
+            {
+                float m = bf16_to_fp32(mrow[j]);
+                if (m < AX_CPU_MASK_THRESHOLD)
+                {
+                    continue;
+                }
+                const unsigned short *kr = j < history ? k_cache + (size_t)j * kv_size + kvh * hd
+                                                       : k_out + (size_t)(j - history) * kv_size + kvh * hd;
+                float s = dot_bf16_f32(kr, qh.data(), hd) * scale + m;
+                scores[cnt] = s;
+                cols[cnt] = j;
+                max_score = std::max(max_score, s);
+                cnt++;
+            }
+
+            float *out = attn.data() + (size_t)t * q_size + h * hd;
+            memset(out, 0, hd * sizeof(float));
+            if (cnt == 0)
+            {
+                continue;
+            }
+            float sum = 0.f;
+            for (int c = 0; c < cnt; c++)
+            {
+                scores[c] = expf(scores[c] - max_score);
+                sum += scores[c];
+            }
+            for (int c = 0; c < cnt; c++)
+            {
+                int j = cols[c];
+                const unsigned short *vr = j < history ? v_cache + (size_t)j * kv_size + kvh * hd
+                                                       : v_out + (size_t)(j - history) * kv_size + kvh * hd;
+                float p = scores[c] / sum;
+                for (int d = 0; d < hd; d++)
+                {
+                    out[d] += p * bf16_to_fp32(vr[d]);
+                }
+            }
+        }
+    }
+
+    auto &tmp = m_handle->tmp;
+    tmp.resize((size_t)n * H);
+    matmul_bf16(m_handle->o_w, nullptr, attn.data(), tmp.data(), n, q_size, H);
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        x[i] += tmp[i];
+    }
+
+    // mlp
+    auto &gate = m_handle->mlp_gate;
+    auto &up = m_handle->mlp_up;
+    gate.resize((size_t)n * I);
+    up.resize((size_t)n * I);
+    rms_norm(x.data(), m_handle->post_norm, xn.data(), n, H, hdr.rms_norm_eps);
+    matmul_bf16(m_handle->gate_w, nullptr, xn.data(), gate.data(), n, H, I);
+    matmul_bf16(m_handle->up_w, nullptr, xn.data(), up.data(), n, H, I);
+    for (size_t i = 0; i < gate.size(); i++)
+    {
+        float g = gate[i];
+        gate[i] = g / (1.f + expf(-g)) * up[i];
+    }
+    matmul_bf16(m_handle->down_w, nullptr, gate.data(), tmp.data(), n, I, H);
+
+    unsigned short *output = (unsigned short *)t_output->pVirAddr;
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        output[i] = fp32_to_bf16(x[i] + tmp[i]);
+    }
+    return 0;
+}
+
+int ax_runner_cpu::run_post(int grpid)
+{
+    auto &hdr = m_handle->header;
+    const int H = hdr.hidden_size, V = hdr.vocab_size;
+
+    auto &x = m_handle->x;
+    auto &xn = m_handle->xn;
+    auto &logits = m_handle->tmp;
+    x.resize(H);
+    xn.resize(H);
+    logits.resize(V);
+
+    const unsigned short *input = (const unsigned short *)mgroup_input_tensors[grpid][0].pVirAddr;
+    for (int i = 0; i < H; i++)
+    {
+        x[i] = bf16_to_fp32(input[i]);
+    }
+    rms_norm(x.data(), m_handle->norm, xn.data(), 1, H, hdr.rms_norm_eps);
+    matmul_bf16(m_handle->lm_head, nullptr, xn.data(), logits.data(), 1, H, V);
+
+    unsigned short *output = nullptr;
+    int *indices = nullptr;
+    for (auto &t : mgroup_output_tensors[grpid])
+    {
+        if (t.sName == "output")
+            output = (unsigned short *)t.pVirAddr;
+        else if (t.sName == "indices")
+            indices = (int *)t.pVirAddr;
+    }
+    int max_index = 0;
+    for (int i = 0; i < V; i++)
+    {
+        if (output)
+        {
+            output[i] = fp32_to_bf16(logits[i]);
+        }
+        if (logits[i] > logits[max_index])
+        {
+            max_index = i;
+        }
+    }
+    if (indices)
+    {
+        *indices = max_index;
+    }
+    return 0;
+}
+
+void ax_runner_cpu::release()
+{
+    if (m_handle)
+    {
+        for (auto ptr : m_handle->io_buffers)
+        {
+            free(ptr);
+        }
+        delete m_handle;
+        m_handle = nullptr;
+    }
+    _parepare_io = false;
+
+    moutput_tensors.clear();
+    minput_tensors.clear();
+    map_input_tensors.clear();
+    map_output_tensors.clear();
+
+    mgroup_output_tensors.clear();
+    mgroup_input_tensors.clear();
+    map_group_input_tensors.clear();
+    map_group_output_tensors.clear();
+}
+
+void ax_runner_cpu::deinit()
+{
+    // 与 ax650 一致，只释放权重，io 保留给下一次 init
+    if (m_handle)
+    {
+        std::vector<unsigned short>().swap(m_handle->weights);
+    }
+}
+
+int ax_runner_cpu::inference()
+{
+    return inference(0);
+}
+
+int ax_runner_cpu::inference(int grpid)
+{
+    if (!m_handle || m_handle->weights.empty())
+    {
+        ALOGE("model not loaded");
+        return -1;
+    }
+    if (grpid < 0 || grpid >= (int)mgroup_input_tensors.size())
+    {
+        ALOGE("invalid grpid(%d)", grpid);
+        return -1;
+    }
+    if (m_handle->header.type == AX_CPU_MODEL_LAYER)
+    {
+        return run_layer(grpid);
+    }
+    return run_post(grpid);
+}
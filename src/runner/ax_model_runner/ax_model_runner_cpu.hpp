@@ -0,0 +1,64 @@
+#pragma once
+#include "ax_model_runner.hpp"
+
+// 模型文件格式见 scripts/export_cpu_model.py
+#define AX_CPU_MODEL_MAGIC 0x55504358 // "XCPU"
+#define AX_CPU_MODEL_VERSION 1
+#define AX_CPU_MODEL_MAX_GROUP 8
+
+typedef enum
+{
+    AX_CPU_MODEL_LAYER = 0,
+    AX_CPU_MODEL_POST = 1,
+} ax_cpu_model_type_e;
+
+typedef enum
+{
+    AX_CPU_MODEL_FLAG_QKV_BIAS = 1 << 0,
+} ax_cpu_model_flag_e;
+
+typedef struct
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int type;
+    unsigned int flags;
+    unsigned int hidden_size;
+    unsigned int num_heads;
+    unsigned int num_kv_heads;
+    unsigned int head_dim;
+    unsigned int intermediate_size;
+    unsigned int vocab_size;
+    unsigned int kv_cache_num;
+    unsigned int prefill_group_num;
+    unsigned int prefill_token_num[AX_CPU_MODEL_MAX_GROUP];
+    unsigned int prefill_kv_cache_num[AX_CPU_MODEL_MAX_GROUP];
+    float rope_theta;
+    float rms_norm_eps;
+    unsigned int reserved[2];
+} ax_cpu_model_header_t;
+
+// host 端参考实现，按 axmodel 相同的 group/tensor 约定在 CPU 上执行单层 decoder 或 post
+// group 0 为 decode，group 1.. 为 prefill
+class ax_runner_cpu : public ax_runner_base
+{
+protected:
+    struct ax_cpu_runner_handle_t *m_handle = nullptr;
+
+    bool _parepare_io = false;
+
+    int sub_init();
+
+    int run_layer(int grpid);
+    int run_post(int grpid);
+
+public:
+    int init(const char *model_file, bool use_mmap = false) override;
+    int init(char *model_buffer, size_t model_size) override;
+
+    void release();
+    void deinit() override;
+
+    int inference() override;
+    int inference(int grpid) override;
+};
@@ -0,0 +1,121 @@
+#include "ax_model_runner_replay.hpp"
+#include "ax_model_trace.hpp"
+#include <string.h>
+#include <stdlib.h>
+#include "sample_log.h"
+
+#define AX_REPLAY_ALIGN_SIZE 128
+
+int ax_runner_replay::sub_init()
+{
+    if (_parepare_io)
+    {
+        return 0;
+    }
+
+    auto &trace = ax_model_trace::get();
+    _trace_model_id = trace.find_model(m_model_name);
+    if (_trace_model_id < 0)
+    {
+        ALOGE("model %s not in trace", m_model_name.c_str());
+        return -1;
+    }
+
+    auto &model = trace.get_model(_trace_model_id);
+    mgroup_input_tensors = model.group_inputs;
+    mgroup_output_tensors = model.group_outputs;
+    for (int io = 0; io < 2; io++)
+    {
+        for (auto &tensors : io == 0 ? mgroup_input_tensors : mgroup_output_tensors)
+        {
+            for (auto &tensor : tensors)
+            {
+                tensor.bCached = false;
+                if (get_alloc_policy(tensor.sName) == AX_RUNNER_ALLOC_SHARED)
+                {
+                    continue;
+                }
+                size_t aligned = (tensor.nSize + AX_REPLAY_ALIGN_SIZE - 1) / AX_REPLAY_ALIGN_SIZE * AX_REPLAY_ALIGN_SIZE;
+                tensor.pVirAddr = aligned > 0 ? aligned_alloc(AX_REPLAY_ALIGN_SIZE, aligned) : nullptr;
+                if (aligned > 0 && !tensor.pVirAddr)
+                {
+                    ALOGE("alloc %s of %s failed", tensor.sName.c_str(), m_model_name.c_str());
+                    return -1;
+                }
+                if (tensor.pVirAddr)
+                {
+                    memset(tensor.pVirAddr, 0, aligned);
+                    m_io_buffers.push_back(tensor.pVirAddr);
+                }
+                tensor.phyAddr = (unsigned long)tensor.pVirAddr;
+            }
+        }
+    }
+
+    share_host_group_inputs(m_io_buffers);
+
+    minput_tensors = mgroup_input_tensors[0];
+    moutput_tensors = mgroup_output_tensors[0];
+    _parepare_io = true;
+    return 0;
+}
+
+int ax_runner_replay::init(const char *model_file, bool use_mmap)
+{
+    if (m_model_name.empty())
+    {
+        m_model_name = model_file;
+    }
+    return sub_init();
+}
+
+int ax_runner_replay::init(char *model_buffer, size_t model_size)
+{
+    // 模型内容不需要，只按模型名查找 trace
+    if (m_model_name.empty())
+    {
+        ALOGE("replay runner needs set_model_name() before init from buffer");
+        return -1;
+    }
+    return sub_init();
+}
+
+void ax_runner_replay::release()
+{
+    for (auto ptr : m_io_buffers)
+    {
+        free(ptr);
+    }
+    m_io_buffers.clear();
+    _parepare_io = false;
+    _trace_model_id = -1;
+
+    moutput_tensors.clear();
+    minput_tensors.clear();
+    map_input_tensors.clear();
+    map_output_tensors.clear();
+
+    mgroup_output_tensors.clear();
+    mgroup_input_tensors.clear();
+    map_group_input_tensors.clear();
+    map_group_output_tensors.clear();
+}
+
+void ax_runner_replay::deinit()
+{
+}
+
+int ax_runner_replay::inference()
+{
+    return inference(0);
+}
+
+int ax_runner_replay::inference(int grpid)
+{
+    if (!_parepare_io || grpid < 0 || grpid >= (int)mgroup_input_tensors.size())
+    {
+        ALOGE("invalid grpid(%d) or model not loaded", grpid);
+        return -1;
+    }
+    return ax_model_trace::get().replay(_trace_model_id, grpid, mgroup_input_tensors[grpid], mgroup_output_tensors[grpid]);
+}
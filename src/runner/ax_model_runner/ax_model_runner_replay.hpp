@@ -0,0 +1,25 @@
+#pragma once
+#include "ax_model_runner.hpp"
+
+// 回放 ax_model_trace 录制的推理结果，不需要 npu 和模型文件
+// 模型按 get_model_name() 的文件名在 trace 中查找，trace 需先通过 ax_model_trace::get().open(path, false) 打开
+class ax_runner_replay : public ax_runner_base
+{
+protected:
+    std::vector<void *> m_io_buffers;
+    int _trace_model_id = -1;
+
+    bool _parepare_io = false;
+
+    int sub_init();
+
+public:
+    int init(const char *model_file, bool use_mmap = false) override;
+    int init(char *model_buffer, size_t model_size) override;
+
+    void release();
+    void deinit() override;
+
+    int inference() override;
+    int inference(int grpid) override;
+};
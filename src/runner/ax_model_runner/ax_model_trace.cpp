@@ -0,0 +1,376 @@
+#include "ax_model_trace.hpp"
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include "memory_utils.hpp"
+#include "sample_log.h"
+
+ax_model_trace &ax_model_trace::get()
+{
+    static ax_model_trace trace;
+    return trace;
+}
+
+std::string ax_model_trace::model_key(const std::string &model_name)
+{
+    auto pos = model_name.find_last_of('/');
+    return pos == std::string::npos ? model_name : model_name.substr(pos + 1);
+}
+
+// 64bit FNV-1a，按 8 字节处理，只用于发现输入不一致
+unsigned long long ax_model_trace::hash(const void *data, size_t size)
+{
+    const unsigned long long prime = 1099511628211ULL;
+    unsigned long long h = 14695981039346656037ULL;
+    const unsigned char *p = (const unsigned char *)data;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        unsigned long long w;
+        memcpy(&w, p + i, sizeof(w));
+        h = (h ^ w) * prime;
+    }
+    for (; i < size; i++)
+    {
+        h = (h ^ p[i]) * prime;
+    }
+    return h;
+}
+
+static void write_u32(std::vector<char> &buf, unsigned int v)
+{
+    buf.insert(buf.end(), (char *)&v, (char *)&v + sizeof(v));
+}
+
+static void write_str(std::vector<char> &buf, const std::string &s)
+{
+    write_u32(buf, s.size());
+    buf.insert(buf.end(), s.begin(), s.end());
+}
+
+struct trace_reader
+{
+    const char *p, *end;
+    bool ok = true;
+
+    unsigned int u32()
+    {
+        unsigned int v = 0;
+        if (p + sizeof(v) > end)
+        {
+            ok = false;
+            return 0;
+        }
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        return v;
+    }
+
+    std::string str()
+    {
+        unsigned int len = u32();
+        if (!ok || p + len > end)
+        {
+            ok = false;
+            return "";
+        }
+        std::string s(p, len);
+        p += len;
+        return s;
+    }
+};
+
+int ax_model_trace::open(const char *path, bool record, bool replay_timing)
+{
+    close();
+    std::lock_guard<std::mutex> guard(lock);
+    b_record = record;
+    b_replay_timing = replay_timing;
+    if (!record)
+    {
+        return load(path);
+    }
+
+    fp = fopen(path, "wb");
+    if (!fp)
+    {
+        ALOGE("open trace %s failed", path);
+        return -1;
+    }
+    setvbuf(fp, nullptr, _IOFBF, 1 << 20);
+    ax_model_trace_header_t header = {AX_MODEL_TRACE_MAGIC, AX_MODEL_TRACE_VERSION};
+    fwrite(&header, sizeof(header), 1, fp);
+    ALOGI("record trace to %s", path);
+    return 0;
+}
+
+int ax_model_trace::load(const char *path)
+{
+    if (!read_file(path, replay_data))
+    {
+        ALOGE("read trace %s failed", path);
+        return -1;
+    }
+    ax_model_trace_header_t header;
+    if (replay_data.size() < sizeof(header))
+    {
+        ALOGE("trace %s too small", path);
+        return -1;
+    }
+    memcpy(&header, replay_data.data(), sizeof(header));
+    if (header.magic != AX_MODEL_TRACE_MAGIC || header.version != AX_MODEL_TRACE_VERSION)
+    {
+        ALOGE("trace %s bad magic(0x%x) or version(%u)", path, header.magic, header.version);
+        return -1;
+    }
+
+    size_t offset = sizeof(header);
+    size_t run_num = 0;
+    while (offset + sizeof(ax_model_trace_chunk_t) <= replay_data.size())
+    {
+        ax_model_trace_chunk_t chunk;
+        memcpy(&chunk, replay_data.data() + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        if (offset + chunk.size > replay_data.size())
+        {
+            // 录制时进程被杀掉，最后一个 chunk 不完整
+            ALOGW("trace %s truncated, ignore last chunk", path);
+            break;
+        }
+        trace_reader r = {replay_data.data() + offset, replay_data.data() + offset + chunk.size};
+        if (chunk.type == AX_MODEL_TRACE_CHUNK_MODEL)
+        {
+            unsigned int model_id = r.u32();
+            ax_model_trace_model_t model;
+            model.name = r.str();
+            unsigned int group_num = r.u32();
+            model.group_inputs.resize(group_num);
+            model.group_outputs.resize(group_num);
+            for (unsigned int g = 0; g < group_num && r.ok; g++)
+            {
+                unsigned int input_num = r.u32();
+                unsigned int output_num = r.u32();
+                for (unsigned int i = 0; i < input_num + output_num && r.ok; i++)
+                {
+                    ax_runner_tensor_t tensor;
+                    tensor.sName = r.str();
+                    tensor.nIdx = i < input_num ? i : i - input_num;
+                    unsigned int ndim = r.u32();
+                    for (unsigned int d = 0; d < ndim && r.ok; d++)
+                    {
+                        tensor.vShape.push_back(r.u32());
+                    }
+                    tensor.nSize = r.u32();
+                    tensor.phyAddr = 0;
+                    tensor.pVirAddr = nullptr;
+                    tensor.bCached = false;
+                    (i < input_num ? model.group_inputs[g] : model.group_outputs[g]).push_back(tensor);
+                }
+            }
+            if (!r.ok || model_id != models.size())
+            {
+                ALOGE("trace %s bad model chunk", path);
+                return -1;
+            }
+            models.push_back(model);
+        }
+        else if (chunk.type == AX_MODEL_TRACE_CHUNK_RUN)
+        {
+            unsigned int model_id = r.u32();
+            if (!r.ok || model_id >= models.size())
+            {
+                ALOGE("trace %s run of unknown model %u", path, model_id);
+                return -1;
+            }
+            models[model_id].runs.push_back(offset);
+            run_num++;
+        }
+        offset += chunk.size;
+    }
+    ALOGI("replay trace %s, %d models, %d runs", path, (int)models.size(), (int)run_num);
+    return 0;
+}
+
+void ax_model_trace::close()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (fp)
+    {
+        fclose(fp);
+        fp = nullptr;
+        ALOGI("trace recorded %d runs, npu %.2f ms", (int)run_count, npu_us / 1000.0);
+    }
+    if (!models.empty() && !b_record)
+    {
+        size_t mismatch = 0;
+        for (auto &model : models)
+        {
+            mismatch += model.input_mismatch;
+        }
+        ALOGI("trace replayed %d runs, recorded npu %.2f ms, input mismatch %d", (int)run_count, npu_us / 1000.0, (int)mismatch);
+    }
+    models.clear();
+    replay_data.clear();
+    run_count = 0;
+    npu_us = 0;
+}
+
+int ax_model_trace::register_model(const std::string &model_name, const std::vector<std::vector<ax_runner_tensor_t>> &group_inputs,
+                                   const std::vector<std::vector<ax_runner_tensor_t>> &group_outputs)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (!fp)
+    {
+        return -1;
+    }
+    std::string key = model_key(model_name);
+    for (size_t i = 0; i < models.size(); i++)
+    {
+        if (models[i].name == key)
+        {
+            return i;
+        }
+    }
+
+    ax_model_trace_model_t model;
+    model.name = key;
+    model.group_inputs = group_inputs;
+    model.group_outputs = group_outputs;
+
+    std::vector<char> buf;
+    write_u32(buf, models.size());
+    write_str(buf, key);
+    write_u32(buf, group_inputs.size());
+    for (size_t g = 0; g < group_inputs.size(); g++)
+    {
+        write_u32(buf, group_inputs[g].size());
+        write_u32(buf, group_outputs[g].size());
+        for (int io = 0; io < 2; io++)
+        {
+            for (auto &tensor : io == 0 ? group_inputs[g] : group_outputs[g])
+            {
+                write_str(buf, tensor.sName);
+                write_u32(buf, tensor.vShape.size());
+                for (auto d : tensor.vShape)
+                {
+                    write_u32(buf, d);
+                }
+                write_u32(buf, tensor.nSize);
+            }
+        }
+    }
+    ax_model_trace_chunk_t chunk = {AX_MODEL_TRACE_CHUNK_MODEL, (unsigned int)buf.size()};
+    fwrite(&chunk, sizeof(chunk), 1, fp);
+    fwrite(buf.data(), buf.size(), 1, fp);
+
+    models.push_back(model);
+    return models.size() - 1;
+}
+
+std::vector<unsigned long long> ax_model_trace::hash_inputs(const std::vector<ax_runner_tensor_t> &inputs)
+{
+    // 在锁外计算 hash，输入可能是非 cached 内存，读取较慢
+    std::vector<unsigned long long> hashes(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        hashes[i] = hash(inputs[i].pVirAddr, inputs[i].nSize);
+    }
+    return hashes;
+}
+
+int ax_model_trace::record(int model_id, int grpid, const std::vector<unsigned long long> &hashes, const std::vector<ax_runner_tensor_t> &outputs, unsigned int duration_us)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (!fp || model_id < 0 || model_id >= (int)models.size())
+    {
+        return -1;
+    }
+    size_t size = sizeof(unsigned int) * 3 + hashes.size() * sizeof(unsigned long long);
+    for (auto &tensor : outputs)
+    {
+        size += tensor.nSize;
+    }
+    ax_model_trace_chunk_t chunk = {AX_MODEL_TRACE_CHUNK_RUN, (unsigned int)size};
+    unsigned int head[3] = {(unsigned int)model_id, (unsigned int)grpid, duration_us};
+    fwrite(&chunk, sizeof(chunk), 1, fp);
+    fwrite(head, sizeof(head), 1, fp);
+    fwrite(hashes.data(), sizeof(unsigned long long), hashes.size(), fp);
+    for (auto &tensor : outputs)
+    {
+        fwrite(tensor.pVirAddr, tensor.nSize, 1, fp);
+    }
+    run_count++;
+    npu_us += duration_us;
+    return 0;
+}
+
+int ax_model_trace::find_model(const std::string &model_name)
+{
+    std::string key = model_key(model_name);
+    for (size_t i = 0; i < models.size(); i++)
+    {
+        if (models[i].name == key)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int ax_model_trace::replay(int model_id, int grpid, const std::vector<ax_runner_tensor_t> &inputs, const std::vector<ax_runner_tensor_t> &outputs)
+{
+    if (model_id < 0 || model_id >= (int)models.size())
+    {
+        return -1;
+    }
+    auto &model = models[model_id];
+    if (model.cursor >= model.runs.size())
+    {
+        ALOGE("trace of %s exhausted after %d runs", model.name.c_str(), (int)model.runs.size());
+        return -1;
+    }
+
+    trace_reader r = {replay_data.data() + model.runs[model.cursor], replay_data.data() + replay_data.size()};
+    r.u32(); // model_id
+    unsigned int rec_grpid = r.u32();
+    unsigned int duration_us = r.u32();
+    if ((int)rec_grpid != grpid)
+    {
+        ALOGE("%s run %d: recorded grpid %u, replay grpid %d", model.name.c_str(), (int)model.cursor, rec_grpid, grpid);
+        return -1;
+    }
+
+    bool match = true;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        unsigned long long h;
+        memcpy(&h, r.p, sizeof(h));
+        r.p += sizeof(h);
+        if (h != hash(inputs[i].pVirAddr, inputs[i].nSize))
+        {
+            match = false;
+            if (model.input_mismatch == 0)
+            {
+                ALOGW("%s run %d: input %s differs from trace", model.name.c_str(), (int)model.cursor, inputs[i].sName.c_str());
+            }
+        }
+    }
+    if (!match)
+    {
+        model.input_mismatch++;
+    }
+    for (auto &tensor : outputs)
+    {
+        memcpy(tensor.pVirAddr, r.p, tensor.nSize);
+        r.p += tensor.nSize;
+    }
+    model.cursor++;
+    run_count++;
+    npu_us += duration_us;
+
+    if (b_replay_timing)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(duration_us));
+    }
+    return 0;
+}
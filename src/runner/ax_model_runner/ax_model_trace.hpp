@@ -0,0 +1,81 @@
+#pragma once
+#include "ax_model_runner.hpp"
+#include <stdio.h>
+#include <mutex>
+
+// trace 文件格式: ax_model_trace_header_t + 若干 chunk
+// chunk: ax_model_trace_chunk_t + payload
+//   MODEL: u32 model_id, u32 name_len, name, u32 group_num, 每个 group: u32 input_num, u32 output_num, 每个 tensor: u32 name_len, name, u32 ndim, u32 shape[ndim], u32 size
+//   RUN:   u32 model_id, u32 grpid, u32 duration_us, u64 input_hash[input_num], 所有 output 的原始数据
+// 输入只记录 hash，用于 replay 时检查 host 端的输入是否和录制时一致
+#define AX_MODEL_TRACE_MAGIC 0x52545841 // "AXTR"
+#define AX_MODEL_TRACE_VERSION 1
+
+typedef enum
+{
+    AX_MODEL_TRACE_CHUNK_MODEL = 0,
+    AX_MODEL_TRACE_CHUNK_RUN = 1,
+} ax_model_trace_chunk_type_e;
+
+typedef struct
+{
+    unsigned int magic;
+    unsigned int version;
+} ax_model_trace_header_t;
+
+typedef struct
+{
+    unsigned int type;
+    unsigned int size;
+} ax_model_trace_chunk_t;
+
+struct ax_model_trace_model_t
+{
+    std::string name;
+    std::vector<std::vector<ax_runner_tensor_t>> group_inputs, group_outputs; // 只有 sName/nIdx/vShape/nSize 有效
+    std::vector<size_t> runs; // replay: RUN chunk payload 在文件中的偏移
+    size_t cursor = 0;
+    size_t input_mismatch = 0;
+};
+
+// 进程内唯一的 trace，录制(ax650 后端)和回放(replay 后端)都通过模型名(文件名，不含路径)对应
+class ax_model_trace
+{
+    std::mutex lock;
+    FILE *fp = nullptr;
+    bool b_record = false;
+    bool b_replay_timing = false;
+    std::vector<char> replay_data;
+    std::vector<ax_model_trace_model_t> models;
+
+    size_t run_count = 0;
+    unsigned long long npu_us = 0;
+
+    int load(const char *path);
+
+public:
+    static ax_model_trace &get();
+    static std::string model_key(const std::string &model_name);
+    static unsigned long long hash(const void *data, size_t size);
+
+    ~ax_model_trace() { close(); }
+
+    // record 为 true 时新建 trace 文件录制，否则读取整个文件用于回放
+    int open(const char *path, bool record, bool replay_timing = false);
+    void close();
+
+    bool recording() { return fp != nullptr; }
+    bool replaying() { return !b_record && !models.empty(); }
+
+    // record
+    int register_model(const std::string &model_name, const std::vector<std::vector<ax_runner_tensor_t>> &group_inputs,
+                       const std::vector<std::vector<ax_runner_tensor_t>> &group_outputs);
+    // 输入的 hash 要在推理之前计算: 输出可能绑定在输入的 buffer 中(例如 K_cache_out 写入 K_cache 的一行)
+    static std::vector<unsigned long long> hash_inputs(const std::vector<ax_runner_tensor_t> &inputs);
+    int record(int model_id, int grpid, const std::vector<unsigned long long> &input_hashes, const std::vector<ax_runner_tensor_t> &outputs, unsigned int duration_us);
+
+    // replay
+    int find_model(const std::string &model_name);
+    const ax_model_trace_model_t &get_model(int model_id) { return models[model_id]; }
+    int replay(int model_id, int grpid, const std::vector<ax_runner_tensor_t> &inputs, const std::vector<ax_runner_tensor_t> &outputs);
+};
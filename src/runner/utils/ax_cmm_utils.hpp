@@ -6,38 +6,29 @@
 
 // #include "sample_log.h"
 
-static std::string exec_cmd(std::string cmd)
+// 直接读 proc 文件，不再 popen(cat | grep)，可以在 init 的各个线程中频繁调用
+static int get_remaining_cmm_size()
 {
-    FILE *pipe = popen(cmd.c_str(), "r");
-    if (!pipe)
+    std::ifstream fin("/proc/ax_proc/mem_cmm_info");
+    if (!fin.is_open())
     {
-        return "";
+        return -1;
     }
-    char buffer[128];
-    std::string result = "";
-    while (!feof(pipe))
+
+    static const std::regex pattern("remain=(\\d+)KB\\((\\d+)MB \\+ (\\d+)KB\\)");
+    std::string line;
+    while (std::getline(fin, line))
     {
-        if (fgets(buffer, 128, pipe) != NULL)
+        if (line.find("total size") == std::string::npos)
         {
-            result += buffer;
+            continue;
+        }
+        std::smatch match;
+        if (std::regex_search(line, match, pattern))
+        {
+            int remain_mb = std::stoi(match[2]);
+            return remain_mb;
         }
-    }
-    pclose(pipe);
-    return result;
-}
-
-static int get_remaining_cmm_size()
-{
-    std::string cmd = "cat /proc/ax_proc/mem_cmm_info |grep 'total size'";
-    std::string result = exec_cmd(cmd);
-
-    std::regex pattern("remain=(\\d+)KB\\((\\d+)MB \\+ (\\d+)KB\\)");
-    std::smatch match;
-    if (std::regex_search(result, match, pattern))
-    {
-        int remain_kb = std::stoi(match[1]);
-        int remain_mb = std::stoi(match[2]);
-        return remain_mb;
     }
     return -1;
-}
\ No newline at end of file
+}
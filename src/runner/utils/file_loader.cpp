@@ -0,0 +1,508 @@
+#include "file_loader.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#include <linux/io_uring.h>
+#define FILE_LOADER_URING 1
+#endif
+
+#include "sample_log.h"
+
+#define FILE_LOADER_ALIGN 4096
+#define FILE_LOADER_MAX_THREADS 8
+
+static size_t align_up(size_t size, size_t align)
+{
+    return (size + align - 1) / align * align;
+}
+
+#ifdef FILE_LOADER_URING
+struct FileLoader::uring_t
+{
+    int fd = -1;
+    unsigned entries = 0;
+    void *sq_ptr = nullptr, *cq_ptr = nullptr;
+    size_t sq_len = 0, cq_len = 0;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqes_len = 0;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_cqe *cqes;
+
+    ~uring_t()
+    {
+        if (sqes)
+            munmap(sqes, sqes_len);
+        if (cq_ptr && cq_ptr != sq_ptr)
+            munmap(cq_ptr, cq_len);
+        if (sq_ptr)
+            munmap(sq_ptr, sq_len);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    // 失败时返回 -errno，调用者退回到线程
+    int setup(unsigned depth)
+    {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        fd = syscall(__NR_io_uring_setup, depth, &p);
+        if (fd < 0)
+        {
+            return -errno;
+        }
+        entries = p.sq_entries;
+        sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single)
+        {
+            sq_len = cq_len = std::max(sq_len, cq_len);
+        }
+        sq_ptr = mmap(NULL, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED)
+        {
+            sq_ptr = nullptr;
+            return -errno;
+        }
+        cq_ptr = single ? sq_ptr : mmap(NULL, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED)
+        {
+            cq_ptr = nullptr;
+            return -errno;
+        }
+        sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe *)mmap(NULL, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+        {
+            sqes = nullptr;
+            return -errno;
+        }
+        char *sq = (char *)sq_ptr, *cq = (char *)cq_ptr;
+        sq_tail = (unsigned *)(sq + p.sq_off.tail);
+        sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+        sq_array = (unsigned *)(sq + p.sq_off.array);
+        cq_head = (unsigned *)(cq + p.cq_off.head);
+        cq_tail = (unsigned *)(cq + p.cq_off.tail);
+        cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+        cqes = (io_uring_cqe *)(cq + p.cq_off.cqes);
+        return 0;
+    }
+
+    // 只有一个线程提交，sq_tail 不需要和其它提交者同步
+    void push_readv(int file_fd, const iovec *iov, size_t offset, unsigned long long user_data)
+    {
+        unsigned tail = *sq_tail;
+        unsigned index = tail & *sq_mask;
+        io_uring_sqe *sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = file_fd;
+        sqe->addr = (unsigned long long)iov;
+        sqe->len = 1;
+        sqe->off = offset;
+        sqe->user_data = user_data;
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    int enter(unsigned to_submit, unsigned min_complete)
+    {
+        int ret;
+        do
+        {
+            ret = syscall(__NR_io_uring_enter, fd, to_submit, min_complete, IORING_ENTER_GETEVENTS, NULL, 0);
+        } while (ret < 0 && errno == EINTR);
+        return ret < 0 ? -errno : ret;
+    }
+
+    template <typename F>
+    void reap(F on_cqe)
+    {
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+            io_uring_cqe *cqe = &cqes[head & *cq_mask];
+            on_cqe(cqe->user_data, cqe->res);
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+};
+#else
+struct FileLoader::uring_t
+{
+};
+#endif
+
+bool FileLoader::Start(const std::vector<std::string> &paths, const option_t &option)
+{
+    Stop();
+    opt = option;
+    opt.queue_depth = std::max(opt.queue_depth, 1);
+    opt.chunk_size = align_up(std::max(opt.chunk_size, (size_t)FILE_LOADER_ALIGN), FILE_LOADER_ALIGN);
+    files.assign(paths.size(), file_t());
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        files[i].path = paths[i];
+    }
+    retry.clear();
+    opened = 0;
+    finished = 0;
+    buffered = 0;
+    read_bytes = 0;
+    elapsed_ms = 0;
+    b_exit = false;
+    b_uring = false;
+    start_time = std::chrono::steady_clock::now();
+    if (files.empty())
+    {
+        return true;
+    }
+
+#ifdef FILE_LOADER_URING
+    if (opt.uring)
+    {
+        ring = new uring_t;
+        int ret = ring->setup(opt.queue_depth);
+        if (ret == 0)
+        {
+            b_uring = true;
+            workers.emplace_back(&FileLoader::uring_loop, this);
+            return true;
+        }
+        ALOGW("io_uring unavailable(%s), read with threads", strerror(-ret));
+        delete ring;
+        ring = nullptr;
+    }
+#endif
+    int threads = std::min(opt.queue_depth, FILE_LOADER_MAX_THREADS);
+    for (int i = 0; i < threads; i++)
+    {
+        workers.emplace_back(&FileLoader::thread_loop, this);
+    }
+    return true;
+}
+
+void FileLoader::Stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        b_exit = true;
+    }
+    cond.notify_all();
+    for (auto &t : workers)
+    {
+        t.join();
+    }
+    workers.clear();
+    delete ring;
+    ring = nullptr;
+    for (auto &f : files)
+    {
+        if (f.fd >= 0)
+        {
+            close(f.fd);
+        }
+        free(f.data);
+    }
+    files.clear();
+    retry.clear();
+    buffered = 0;
+}
+
+// 按顺序打开下一个文件并分配 buffer，超出 max_buffered 时等 Release
+bool FileLoader::open_next()
+{
+    if (opened >= (int)files.size())
+    {
+        return false;
+    }
+    file_t &f = files[opened];
+    struct stat st;
+    if (stat(f.path.c_str(), &st) != 0)
+    {
+        ALOGE("stat(%s) failed: %s", f.path.c_str(), strerror(errno));
+        f.error = true;
+        opened++;
+        try_finish(f);
+        return true;
+    }
+    size_t capacity = align_up(std::max((size_t)st.st_size, (size_t)1), FILE_LOADER_ALIGN);
+    if (buffered > 0 && buffered + capacity > opt.max_buffered)
+    {
+        return false;
+    }
+
+    f.direct = opt.direct;
+    f.fd = f.direct ? open(f.path.c_str(), O_RDONLY | O_DIRECT) : -1;
+    if (f.fd < 0)
+    {
+        f.direct = false;
+        f.fd = open(f.path.c_str(), O_RDONLY);
+    }
+    if (f.fd < 0 || posix_memalign((void **)&f.data, FILE_LOADER_ALIGN, capacity) != 0)
+    {
+        ALOGE("open(%s) failed: %s", f.path.c_str(), strerror(errno));
+        f.data = nullptr;
+        f.error = true;
+        opened++;
+        try_finish(f);
+        return true;
+    }
+    if (!f.direct)
+    {
+        posix_fadvise(f.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    f.size = st.st_size;
+    f.capacity = capacity;
+    f.state = FILE_READING;
+    buffered += capacity;
+    opened++;
+    try_finish(f);
+    return true;
+}
+
+// 所有请求都完成(或出错后不再有进行中的请求)时关闭文件
+void FileLoader::try_finish(file_t &f)
+{
+    if (f.state == FILE_DONE || f.state == FILE_FAILED || f.state == FILE_RELEASED || f.pending > 0 || (!f.error && f.next < f.size))
+    {
+        return;
+    }
+    if (f.fd >= 0)
+    {
+        close(f.fd);
+        f.fd = -1;
+    }
+    f.state = f.error || f.done != f.size ? FILE_FAILED : FILE_DONE;
+    read_bytes += f.done;
+    if (++finished == (int)files.size())
+    {
+        elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+    }
+    cond.notify_all();
+}
+
+bool FileLoader::next_request(request_t &r)
+{
+    while (!retry.empty())
+    {
+        r = retry.front();
+        retry.pop_front();
+        file_t &f = files[r.file];
+        if (!f.error)
+        {
+            return true;
+        }
+        f.pending--;
+        try_finish(f);
+    }
+    do
+    {
+        for (int i = 0; i < opened; i++)
+        {
+            file_t &f = files[i];
+            if (f.state != FILE_READING || f.error || f.next >= f.size)
+            {
+                continue;
+            }
+            size_t len = std::min(opt.chunk_size, f.size - f.next);
+            // O_DIRECT 的长度也要对齐，文件末尾会短读，buffer 已经按对齐后的大小分配
+            r = {i, f.next, f.direct ? align_up(len, FILE_LOADER_ALIGN) : len};
+            f.next += len;
+            f.pending++;
+            return true;
+        }
+    } while (open_next());
+    return false;
+}
+
+void FileLoader::complete(const request_t &r, long res)
+{
+    file_t &f = files[r.file];
+    if (res == -EINVAL && f.direct)
+    {
+        // 文件系统不支持 O_DIRECT 或者 offset 不对齐，去掉 O_DIRECT 重读
+        int flags = fcntl(f.fd, F_GETFL);
+        fcntl(f.fd, F_SETFL, flags & ~O_DIRECT);
+        f.direct = false;
+        retry.push_back({r.file, r.offset, std::min(r.len, f.size - r.offset)});
+        return;
+    }
+    size_t want = std::min(r.len, f.size - r.offset);
+    if (res < 0 || (res == 0 && want > 0))
+    {
+        ALOGE("read(%s) at %ld failed: %s", f.path.c_str(), (long)r.offset, res < 0 ? strerror(-res) : "unexpected eof");
+        f.error = true;
+    }
+    else if ((size_t)res < want)
+    {
+        f.done += res;
+        retry.push_back({r.file, r.offset + res, want - res});
+        return;
+    }
+    else
+    {
+        f.done += want;
+    }
+    f.pending--;
+    try_finish(f);
+}
+
+void FileLoader::thread_loop()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (true)
+    {
+        request_t r;
+        while (!b_exit && finished < (int)files.size() && !next_request(r))
+        {
+            cond.wait(guard);
+        }
+        if (b_exit || finished == (int)files.size())
+        {
+            return;
+        }
+        int fd = files[r.file].fd;
+        char *dst = files[r.file].data + r.offset;
+        guard.unlock();
+        long res = pread(fd, dst, r.len, r.offset);
+        if (res < 0)
+        {
+            res = -errno;
+        }
+        guard.lock();
+        complete(r, res);
+    }
+}
+
+void FileLoader::uring_loop()
+{
+#ifdef FILE_LOADER_URING
+    struct slot_t
+    {
+        request_t req;
+        iovec iov;
+        bool busy = false;
+    };
+    std::vector<slot_t> slots(ring->entries);
+    std::vector<int> free_slots;
+    for (int i = (int)slots.size() - 1; i >= 0; i--)
+    {
+        free_slots.push_back(i);
+    }
+    int inflight = 0;
+    unsigned unsubmitted = 0; // 已经放入 sq 但内核还没取走的 sqe
+
+    std::unique_lock<std::mutex> guard(lock);
+    while (true)
+    {
+        request_t r;
+        while (!b_exit && !free_slots.empty() && next_request(r))
+        {
+            int s = free_slots.back();
+            free_slots.pop_back();
+            slots[s].req = r;
+            slots[s].busy = true;
+            slots[s].iov.iov_base = files[r.file].data + r.offset;
+            slots[s].iov.iov_len = r.len;
+            ring->push_readv(files[r.file].fd, &slots[s].iov, r.offset, s);
+            unsubmitted++;
+            inflight++;
+        }
+        if (inflight == 0)
+        {
+            if (b_exit || finished == (int)files.size())
+            {
+                return;
+            }
+            cond.wait(guard);
+            continue;
+        }
+
+        guard.unlock();
+        int ret = ring->enter(unsubmitted, 1);
+        guard.lock();
+        if (ret >= 0)
+        {
+            unsubmitted -= std::min((unsigned)ret, unsubmitted);
+        }
+        else if (ret != -EAGAIN && ret != -EBUSY)
+        {
+            // io_uring 不能用了，没完成的请求交给线程重读
+            ALOGW("io_uring_enter failed(%s), read with threads", strerror(-ret));
+            for (auto &slot : slots)
+            {
+                if (slot.busy)
+                {
+                    retry.push_back(slot.req);
+                }
+            }
+            b_uring = false;
+            guard.unlock();
+            thread_loop();
+            return;
+        }
+        ring->reap([&](unsigned long long user_data, int res)
+                   {
+                       slot_t &slot = slots[user_data];
+                       slot.busy = false;
+                       complete(slot.req, res);
+                       free_slots.push_back((int)user_data);
+                       inflight--; });
+    }
+#endif
+}
+
+char *FileLoader::Wait(int i, size_t *size)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    cond.wait(guard, [&]
+              { return b_exit || files[i].state == FILE_DONE || files[i].state == FILE_FAILED || files[i].state == FILE_RELEASED; });
+    if (files[i].state != FILE_DONE)
+    {
+        *size = 0;
+        return nullptr;
+    }
+    *size = files[i].size;
+    return files[i].data;
+}
+
+void FileLoader::Release(int i)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        file_t &f = files[i];
+        if (f.state != FILE_DONE && f.state != FILE_FAILED)
+        {
+            return;
+        }
+        free(f.data);
+        f.data = nullptr;
+        buffered -= f.capacity;
+        f.state = FILE_RELEASED;
+    }
+    cond.notify_all();
+}
+
+double FileLoader::ElapsedMs()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return elapsed_ms;
+}
+
+size_t FileLoader::ReadBytes()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return read_bytes;
+}
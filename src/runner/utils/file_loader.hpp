@@ -0,0 +1,102 @@
+#pragma once
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+
+struct file_loader_option_t
+{
+    int queue_depth = 16;
+    size_t chunk_size = 1 << 20;
+    size_t max_buffered = 256 << 20;
+    bool direct = false; // O_DIRECT 读入 4096 对齐的 buffer，不经过 page cache；文件系统不支持时自动关闭
+    bool uring = true;   // false 时直接使用线程
+};
+
+// 后台按顺序读入一组文件，每个文件切成 chunk，同时有 queue_depth 个读请求在进行
+// 优先用 io_uring(直接使用系统调用，不依赖 liburing)，内核不支持或被禁用时退回到多个线程 pread
+// 读完的文件由 Wait 取走，用完后 Release；已读入还没 Release 的总大小不超过 max_buffered(单个文件超过时仍会读)
+class FileLoader
+{
+public:
+    typedef file_loader_option_t option_t;
+
+private:
+    enum
+    {
+        FILE_WAIT,
+        FILE_READING,
+        FILE_DONE,
+        FILE_FAILED,
+        FILE_RELEASED,
+    };
+
+    struct file_t
+    {
+        std::string path;
+        int fd = -1;
+        size_t size = 0;
+        char *data = nullptr;
+        size_t capacity = 0; // data 按 4096 对齐后的大小
+        size_t next = 0;     // 下一个要提交的 offset
+        size_t done = 0;     // 已经读完的字节数
+        int pending = 0;     // 已提交还没完成的请求，包括等待重试的
+        int state = FILE_WAIT;
+        bool direct = false;
+        bool error = false;
+    };
+
+    struct request_t
+    {
+        int file;
+        size_t offset;
+        size_t len;
+    };
+
+    option_t opt;
+    std::vector<file_t> files;
+    std::deque<request_t> retry; // 短读剩下的部分和需要去掉 O_DIRECT 重读的请求
+    int opened = 0;              // 下一个要打开的文件
+    int finished = 0;
+    size_t buffered = 0;
+    bool b_exit = false;
+    bool b_uring = false;
+    size_t read_bytes = 0;
+    double elapsed_ms = 0;
+    std::chrono::steady_clock::time_point start_time;
+
+    struct uring_t;
+    uring_t *ring = nullptr;
+
+    std::mutex lock;
+    std::condition_variable cond;
+    std::vector<std::thread> workers;
+
+    bool open_next();
+    void try_finish(file_t &f);
+    bool next_request(request_t &r);
+    void complete(const request_t &r, long res);
+
+    void uring_loop();
+    void thread_loop();
+
+public:
+    ~FileLoader() { Stop(); }
+
+    bool Start(const std::vector<std::string> &paths, const option_t &option = option_t());
+    // 等 Start 中的所有线程退出，没取走的 buffer 一起释放
+    void Stop();
+
+    // 等待第 i 个文件读完，失败返回 nullptr
+    char *Wait(int i, size_t *size);
+    void Release(int i);
+
+    const char *Backend() { return b_uring ? "io_uring" : "thread"; }
+    // 从 Start 到最后一个文件读完的耗时
+    double ElapsedMs();
+    size_t ReadBytes();
+};
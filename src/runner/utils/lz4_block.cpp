@@ -0,0 +1,199 @@
+#include "lz4_block.hpp"
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5 // 最后 5 个字节必须是 literal
+#define LZ4_MF_LIMIT 12     // 最后一个 match 必须在结尾 12 字节之前开始
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_LOG 16
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t hash32(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
+
+// 长度 >= 15 时后面跟若干个 255 和一个余数
+static inline uint8_t *write_length(uint8_t *op, size_t len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+size_t lz4_compress_bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t lz4_compress(const char *src, size_t size, char *dst, size_t capacity)
+{
+    const uint8_t *base = (const uint8_t *)src;
+    const uint8_t *ip = base;
+    const uint8_t *anchor = base;
+    const uint8_t *iend = base + size;
+    uint8_t *op = (uint8_t *)dst;
+    uint8_t *oend = op + capacity;
+
+    if (size > LZ4_MF_LIMIT && size <= 0xFFFFFFFFu)
+    {
+        std::vector<uint32_t> table(1 << LZ4_HASH_LOG, 0);
+        const uint8_t *mflimit = iend - LZ4_MF_LIMIT;
+        const uint8_t *matchlimit = iend - LZ4_LAST_LITERALS;
+        while (ip < mflimit)
+        {
+            uint32_t seq = read32(ip);
+            uint32_t h = hash32(seq);
+            const uint8_t *ref = base + table[h];
+            table[h] = (uint32_t)(ip - base);
+            if (ref >= ip || ip - ref > LZ4_MAX_OFFSET || read32(ref) != seq)
+            {
+                ip++;
+                continue;
+            }
+
+            const uint8_t *mp = ip + LZ4_MIN_MATCH;
+            const uint8_t *rp = ref + LZ4_MIN_MATCH;
+            while (mp < matchlimit && *mp == *rp)
+            {
+                mp++;
+                rp++;
+            }
+
+            size_t lit = ip - anchor;
+            size_t mlen = mp - ip - LZ4_MIN_MATCH;
+            if (op + 1 + lit / 255 + 1 + lit + 2 + mlen / 255 + 1 > oend)
+            {
+                return 0;
+            }
+            uint8_t *token = op++;
+            *token = (uint8_t)(((lit < 15 ? lit : 15) << 4) | (mlen < 15 ? mlen : 15));
+            if (lit >= 15)
+            {
+                op = write_length(op, lit - 15);
+            }
+            memcpy(op, anchor, lit);
+            op += lit;
+            uint16_t offset = (uint16_t)(ip - ref);
+            *op++ = offset & 0xff;
+            *op++ = offset >> 8;
+            if (mlen >= 15)
+            {
+                op = write_length(op, mlen - 15);
+            }
+
+            ip = mp;
+            anchor = ip;
+        }
+    }
+
+    size_t lit = iend - anchor;
+    if (op + 1 + lit / 255 + 1 + lit > oend)
+    {
+        return 0;
+    }
+    *op++ = (uint8_t)((lit < 15 ? lit : 15) << 4);
+    if (lit >= 15)
+    {
+        op = write_length(op, lit - 15);
+    }
+    memcpy(op, anchor, lit);
+    op += lit;
+    return op - (uint8_t *)dst;
+}
+
+int lz4_decompress(const char *src, size_t size, char *dst, size_t raw_size)
+{
+    const uint8_t *ip = (const uint8_t *)src;
+    const uint8_t *iend = ip + size;
+    uint8_t *op = (uint8_t *)dst;
+    uint8_t *oend = op + raw_size;
+
+    while (ip < iend)
+    {
+        uint8_t token = *ip++;
+        size_t lit = token >> 4;
+        if (lit == 15)
+        {
+            uint8_t b;
+            do
+            {
+                if (ip >= iend)
+                {
+                    return -1;
+                }
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+        if (lit > (size_t)(iend - ip) || lit > (size_t)(oend - op))
+        {
+            return -1;
+        }
+        memcpy(op, ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip >= iend)
+        {
+            // 最后一个序列只有 literal
+            break;
+        }
+
+        if (iend - ip < 2)
+        {
+            return -1;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - (uint8_t *)dst))
+        {
+            return -1;
+        }
+        size_t mlen = token & 15;
+        if (mlen == 15)
+        {
+            uint8_t b;
+            do
+            {
+                if (ip >= iend)
+                {
+                    return -1;
+                }
+                b = *ip++;
+                mlen += b;
+            } while (b == 255);
+        }
+        mlen += LZ4_MIN_MATCH;
+        if (mlen > (size_t)(oend - op))
+        {
+            return -1;
+        }
+        const uint8_t *ref = op - offset;
+        if (offset >= mlen)
+        {
+            memcpy(op, ref, mlen);
+            op += mlen;
+        }
+        else
+        {
+            // 重叠的 match 按字节复制，重复前面的内容
+            for (size_t i = 0; i < mlen; i++)
+            {
+                *op++ = ref[i];
+            }
+        }
+    }
+    return op == oend ? 0 : -1;
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <stddef.h>
+
+// lz4 block 格式(不带 frame 头)的压缩和解压，用于在内存中压缩保存模型
+// 压缩使用单个 hash 表的贪心匹配，速度优先
+
+// 压缩后最大可能的大小
+size_t lz4_compress_bound(size_t size);
+
+// 返回压缩后的大小，dst 空间不够时返回 0
+size_t lz4_compress(const char *src, size_t size, char *dst, size_t capacity);
+
+// 解压后的大小必须正好是 raw_size，成功返回 0
+int lz4_decompress(const char *src, size_t size, char *dst, size_t raw_size);
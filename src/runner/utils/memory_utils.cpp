@@ -1,4 +1,8 @@
 #include "memory_utils.hpp"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <algorithm>
 
 bool file_exist(const std::string &path)
 {
@@ -63,3 +67,126 @@ bool read_file(const std::string &path, char **data, size_t *len)
 
     return true;
 }
+
+#define MMAP_HUGEPAGE_SIZE (2UL << 20)
+#define MMAP_WARMUP_CHUNK (16UL << 20)
+
+// 先占一段多 2MB 的地址，再把文件固定映射到其中 2MB 对齐的位置，文件偏移 0 和大页对齐
+static void *mmap_hugepage_aligned(int fd, size_t size, int flags)
+{
+    void *reserve = mmap(NULL, size + MMAP_HUGEPAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserve == MAP_FAILED)
+    {
+        return MAP_FAILED;
+    }
+    uintptr_t begin = (uintptr_t)reserve;
+    uintptr_t aligned = (begin + MMAP_HUGEPAGE_SIZE - 1) & ~(MMAP_HUGEPAGE_SIZE - 1);
+    void *add = mmap((void *)aligned, size, PROT_READ, flags | MAP_FIXED, fd, 0);
+    if (add == MAP_FAILED)
+    {
+        munmap(reserve, size + MMAP_HUGEPAGE_SIZE);
+        return MAP_FAILED;
+    }
+    // 释放前后多占的地址
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t mapped_end = (aligned + size + page - 1) / page * page;
+    if (aligned > begin)
+    {
+        munmap(reserve, aligned - begin);
+    }
+    if (begin + size + MMAP_HUGEPAGE_SIZE > mapped_end)
+    {
+        munmap((void *)mapped_end, begin + size + MMAP_HUGEPAGE_SIZE - mapped_end);
+    }
+    madvise(add, size, MADV_HUGEPAGE);
+    return add;
+}
+
+bool MMap::open_file(const char *file, const option_t &opt)
+{
+    close_file();
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    int flags = MAP_PRIVATE | (opt.populate ? MAP_POPULATE : 0);
+    void *add = opt.hugepage ? mmap_hugepage_aligned(fd, size, flags) : mmap(NULL, size, PROT_READ, flags, fd, 0);
+    close(fd);
+    if (add == MAP_FAILED)
+    {
+        return false;
+    }
+    _add = add;
+    _size = size;
+    if (opt.advice != MADV_NORMAL)
+    {
+        advise(opt.advice);
+    }
+    return true;
+}
+
+void MMap::close_file()
+{
+    if (_add)
+    {
+        munmap(_add, _size);
+        _add = nullptr;
+    }
+    _size = 0;
+}
+
+int MMap::advise(int advice, size_t offset, size_t len)
+{
+    if (!_add || offset >= _size)
+    {
+        return -1;
+    }
+    if (len == 0 || len > _size - offset)
+    {
+        len = _size - offset;
+    }
+    // madvise 要求起始地址按页对齐
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t begin = offset / page * page;
+    return madvise((char *)_add + begin, len + offset - begin, advice);
+}
+
+void MMap::warmup(const std::function<void(size_t, size_t)> &progress, size_t offset, size_t len)
+{
+    if (!_add || offset >= _size)
+    {
+        return;
+    }
+    if (len == 0 || len > _size - offset)
+    {
+        len = _size - offset;
+    }
+    size_t page = sysconf(_SC_PAGESIZE);
+    const volatile char *p = (const volatile char *)_add + offset;
+    char sink = 0;
+    for (size_t done = 0; done < len;)
+    {
+        size_t chunk = std::min(MMAP_WARMUP_CHUNK, len - done);
+        // 先让内核异步预读这一段，再逐页访问建立页表
+        advise(MADV_WILLNEED, offset + done, chunk);
+        for (size_t i = 0; i < chunk; i += page)
+        {
+            sink ^= p[done + i];
+        }
+        sink ^= p[done + chunk - 1];
+        done += chunk;
+        if (progress)
+        {
+            progress(done, len);
+        }
+    }
+    (void)sink;
+}
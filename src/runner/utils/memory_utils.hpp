@@ -4,71 +4,74 @@
 #include <stdio.h>
 #include <fstream>
 #include <vector>
+#include <functional>
 
 bool file_exist(const std::string &path);
 
 bool read_file(const std::string &path, std::vector<char> &data);
 bool read_file(const std::string &path, char **data, size_t *len);
+struct mmap_option_t
+{
+    int advice = MADV_NORMAL; // MADV_SEQUENTIAL: 顺序读一遍(模型文件)，MADV_RANDOM: 随机读(embed)，MADV_WILLNEED: 后台预读
+    bool populate = false;    // MAP_POPULATE，映射时就读入并建立页表
+    bool hugepage = false;    // 按 2MB 对齐映射并 MADV_HUGEPAGE，内核不支持文件的透明大页时没有效果
+};
+
+// 只读的私有映射，映射后 fd 立即关闭
 class MMap
 {
+public:
+    typedef mmap_option_t option_t;
+
 private:
     void *_add = nullptr;
-    int _size;
+    size_t _size = 0;
 
 public:
     MMap() {}
-    MMap(const char *file)
+    MMap(const char *file, const option_t &opt = option_t())
     {
-        open_file(file);
+        open_file(file, opt);
     }
-    ~MMap()
+    MMap(const MMap &) = delete;
+    MMap &operator=(const MMap &) = delete;
+    MMap(MMap &&other) noexcept : _add(other._add), _size(other._size)
     {
-        close_file();
+        other._add = nullptr;
+        other._size = 0;
     }
-
-    bool open_file(const char *file)
+    MMap &operator=(MMap &&other) noexcept
     {
-        _add = _mmap(file, &_size);
-        if (!_add)
+        if (this != &other)
         {
-            return false;
+            close_file();
+            std::swap(_add, other._add);
+            std::swap(_size, other._size);
         }
-        return true;
+        return *this;
     }
-
-    void close_file()
+    ~MMap()
     {
-        if (_add)
-        {
-            munmap(_add, _size);
-            _add = nullptr;
-            _size = 0;
-        }
+        close_file();
     }
 
-    size_t size()
+    bool open_file(const char *file, const option_t &opt = option_t());
+    void close_file();
+
+    size_t size() const
     {
         return _size;
     }
 
-    void *data()
+    void *data() const
     {
         return _add;
     }
 
-    static void *_mmap(const char *model_file, int *model_size)
-    {
-        auto *file_fp = fopen(model_file, "r");
-        if (!file_fp)
-        {
+    // 对 [offset, offset + len) 所在的页设置 advice，len 为 0 表示到结尾
+    int advise(int advice, size_t offset = 0, size_t len = 0);
 
-            return nullptr;
-        }
-        fseek(file_fp, 0, SEEK_END);
-        *model_size = ftell(file_fp);
-        fclose(file_fp);
-        int fd = open(model_file, O_RDWR, 0644);
-        void *mmap_add = mmap(NULL, *model_size, PROT_WRITE, MAP_SHARED, fd, 0);
-        return mmap_add;
-    }
-};
\ No newline at end of file
+    // 逐页读一遍 [offset, offset + len)，文件进入 page cache 并建立页表，之后访问不再缺页
+    // progress(已完成字节数, 总字节数) 每 16MB 调用一次
+    void warmup(const std::function<void(size_t, size_t)> &progress = nullptr, size_t offset = 0, size_t len = 0);
+};
@@ -0,0 +1,76 @@
+#include "model_bundle.hpp"
+#include <string.h>
+
+#include "sample_log.h"
+
+bool ModelBundle::open_file(const std::string &path, const MMap::option_t &opt)
+{
+    close_file();
+    if (!_map.open_file(path.c_str(), opt))
+    {
+        ALOGE("mmap bundle(%s) failed", path.c_str());
+        return false;
+    }
+    char *add = (char *)_map.data();
+    size_t size = _map.size();
+    _path = path;
+
+    ax_bundle_header_t hdr;
+    if (size < sizeof(hdr))
+    {
+        ALOGE("bundle(%s) too small", path.c_str());
+        close_file();
+        return false;
+    }
+    memcpy(&hdr, add, sizeof(hdr));
+    if (memcmp(hdr.magic, AX_BUNDLE_MAGIC, sizeof(hdr.magic)) != 0 || hdr.version != AX_BUNDLE_VERSION)
+    {
+        ALOGE("bundle(%s) bad magic or version(%d)", path.c_str(), hdr.version);
+        close_file();
+        return false;
+    }
+    if (hdr.table_offset > size || hdr.entry_num > (size - hdr.table_offset) / sizeof(ax_bundle_entry_t) ||
+        hdr.meta_offset > size || hdr.meta_size > size - hdr.meta_offset)
+    {
+        ALOGE("bundle(%s) truncated", path.c_str());
+        close_file();
+        return false;
+    }
+
+    _entries.resize(hdr.entry_num);
+    memcpy(_entries.data(), add + hdr.table_offset, hdr.entry_num * sizeof(ax_bundle_entry_t));
+    for (auto &e : _entries)
+    {
+        e.name[AX_BUNDLE_NAME_LEN - 1] = 0;
+        if (e.offset > size || e.size > size - e.offset)
+        {
+            ALOGE("bundle(%s) entry %s out of range", path.c_str(), e.name);
+            close_file();
+            return false;
+        }
+    }
+    _meta.assign(add + hdr.meta_offset, hdr.meta_size);
+    ALOGI("bundle(%s): %d entries, %.2f MB", path.c_str(), (int)_entries.size(), size / 1024.0 / 1024.0);
+    return true;
+}
+
+void ModelBundle::close_file()
+{
+    _map.close_file();
+    _entries.clear();
+    _meta.clear();
+}
+
+char *ModelBundle::find(const std::string &name, size_t *size)
+{
+    for (auto &e : _entries)
+    {
+        if (name == e.name)
+        {
+            *size = e.size;
+            return (char *)_map.data() + e.offset;
+        }
+    }
+    *size = 0;
+    return nullptr;
+}
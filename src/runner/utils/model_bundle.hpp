@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "memory_utils.hpp"
+
+// 单文件模型包，由 scripts/pack_model_bundle.py 生成，小端:
+//   header | entry table | meta json | 按页对齐的各个 payload(layer.%d/post/vpm_encoder/vpm_resampler/embed)
+// 整个文件只 mmap 一次，各模型直接从映射的内存 init
+#define AX_BUNDLE_MAGIC "AXLLMPKG"
+#define AX_BUNDLE_VERSION 1
+#define AX_BUNDLE_NAME_LEN 48
+
+struct ax_bundle_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_num;
+    uint64_t table_offset;
+    uint64_t meta_offset;
+    uint64_t meta_size;
+    uint32_t align; // payload 的对齐，一般是 4096
+    uint32_t reserved;
+};
+
+struct ax_bundle_entry_t
+{
+    char name[AX_BUNDLE_NAME_LEN];
+    uint64_t offset;
+    uint64_t size;
+    uint32_t crc32; // 只给打包工具校验用，加载时不计算
+    uint32_t reserved;
+};
+
+static_assert(sizeof(ax_bundle_header_t) == 48, "bundle header layout");
+static_assert(sizeof(ax_bundle_entry_t) == 72, "bundle entry layout");
+
+class ModelBundle
+{
+private:
+    MMap _map;
+    std::string _path;
+    std::string _meta;
+    std::vector<ax_bundle_entry_t> _entries;
+
+public:
+    ModelBundle() {}
+    ModelBundle(const ModelBundle &) = delete;
+    ModelBundle &operator=(const ModelBundle &) = delete;
+    ~ModelBundle() { close_file(); }
+
+    bool open_file(const std::string &path, const MMap::option_t &opt = MMap::option_t());
+    void close_file();
+
+    bool is_open() { return _map.data() != nullptr; }
+    const std::string &path() { return _path; }
+    size_t size() { return _map.size(); }
+    MMap &mapping() { return _map; }
+
+    // 模型的 meta json，字段名和 LLMAttrType 的成员一致
+    const std::string &meta() { return _meta; }
+
+    // 返回 payload 在映射内存中的地址，不存在时返回 nullptr
+    char *find(const std::string &name, size_t *size);
+    bool has(const std::string &name)
+    {
+        size_t size;
+        return find(name, &size) != nullptr;
+    }
+};
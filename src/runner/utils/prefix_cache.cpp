@@ -0,0 +1,167 @@
+#include "prefix_cache.hpp"
+#include <string.h>
+
+bool PrefixCache::Init(size_t capacity, size_t row_bytes)
+{
+    _row_bytes = 0;
+    _arena.clear();
+    _arena.shrink_to_fit();
+    if (row_bytes == 0 || capacity < row_bytes)
+    {
+        Clear();
+        return false;
+    }
+    _row_bytes = row_bytes;
+    _arena.resize(capacity / row_bytes * row_bytes);
+    Clear();
+    _stats = stats_t();
+    return true;
+}
+
+void PrefixCache::Clear()
+{
+    _nodes.assign(1, node_t());
+    _free_nodes.clear();
+    _free_slots.clear();
+    for (int i = Capacity() - 1; i >= 0; i--)
+    {
+        _free_slots.push_back(i);
+    }
+}
+
+int PrefixCache::child(int node, uint64_t key)
+{
+    auto &children = _nodes[node].children;
+    auto it = children.find(key);
+    return it == children.end() ? -1 : it->second;
+}
+
+bool PrefixCache::evict(const std::vector<int> &keep)
+{
+    int victim = -1;
+    for (int i = 1; i < (int)_nodes.size(); i++)
+    {
+        auto &n = _nodes[i];
+        if (n.slot < 0 || !n.children.empty())
+        {
+            continue;
+        }
+        if (victim < 0 || n.last_use < _nodes[victim].last_use)
+        {
+            bool b_keep = false;
+            for (int k : keep)
+            {
+                b_keep |= k == i;
+            }
+            if (!b_keep)
+            {
+                victim = i;
+            }
+        }
+    }
+    if (victim < 0)
+    {
+        return false;
+    }
+    auto &n = _nodes[victim];
+    _nodes[n.parent].children.erase(n.key);
+    _free_slots.push_back(n.slot);
+    n = node_t();
+    _free_nodes.push_back(victim);
+    _stats.evicted++;
+    return true;
+}
+
+int PrefixCache::Match(const std::vector<uint64_t> &keys, int max_len, std::vector<const char *> &rows)
+{
+    rows.clear();
+    if (!Enabled())
+    {
+        return 0;
+    }
+    _clock++;
+    int node = 0;
+    for (int i = 0; i < max_len && i < (int)keys.size(); i++)
+    {
+        node = child(node, keys[i]);
+        if (node < 0)
+        {
+            break;
+        }
+        _nodes[node].last_use = _clock;
+        rows.push_back(_arena.data() + (size_t)_nodes[node].slot * _row_bytes);
+    }
+    _stats.lookups++;
+    _stats.lookup_tokens += max_len;
+    _stats.hits += rows.empty() ? 0 : 1;
+    _stats.hit_tokens += rows.size();
+    return rows.size();
+}
+
+int PrefixCache::Insert(const std::vector<uint64_t> &keys, int n, std::function<void(int, char *)> fill)
+{
+    if (!Enabled())
+    {
+        return 0;
+    }
+    _clock++;
+    int node = 0, added = 0;
+    std::vector<int> path;
+    for (int i = 0; i < n && i < (int)keys.size(); i++)
+    {
+        int next = child(node, keys[i]);
+        if (next < 0)
+        {
+            // 路径上的节点不能被淘汰，否则刚插入的位置会失去前缀
+            if (_free_slots.empty() && !evict(path))
+            {
+                break;
+            }
+            if (_free_nodes.empty())
+            {
+                next = _nodes.size();
+                _nodes.emplace_back();
+            }
+            else
+            {
+                next = _free_nodes.back();
+                _free_nodes.pop_back();
+            }
+            auto &nn = _nodes[next];
+            nn.key = keys[i];
+            nn.parent = node;
+            nn.slot = _free_slots.back();
+            _free_slots.pop_back();
+            _nodes[node].children[keys[i]] = next;
+            fill(i, _arena.data() + (size_t)nn.slot * _row_bytes);
+            added++;
+        }
+        _nodes[next].last_use = _clock;
+        path.push_back(next);
+        node = next;
+    }
+    _stats.inserted += added;
+    return added;
+}
+
+uint64_t PrefixCache::Hash(const void *data, size_t size, uint64_t seed)
+{
+    // 按 8 字节混合，剩下的字节逐个处理
+    const uint64_t prime = 0x100000001b3ULL;
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+    const unsigned char *p = (const unsigned char *)data;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * prime;
+        h ^= h >> 29;
+    }
+    for (; i < size; i++)
+    {
+        h = (h ^ p[i]) * prime;
+    }
+    h ^= h >> 32;
+    return h * 0x9e3779b97f4a7c15ULL;
+}
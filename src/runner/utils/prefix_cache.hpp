@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+
+// 输入前缀的 kv cache: 按 token 的 key(token embed 的 hash)建 trie，每个节点保存这个位置所有层的 K/V 行
+// 节点的数据放在一块按 row_bytes 切分的 host 内存中，满了之后淘汰最久没用到的叶子节点
+class PrefixCache
+{
+public:
+    struct stats_t
+    {
+        int lookups = 0;
+        int hits = 0;
+        long lookup_tokens = 0; // 查询的 token 总数
+        long hit_tokens = 0;    // 其中从缓存恢复的
+        long inserted = 0;
+        long evicted = 0;
+    };
+
+private:
+    struct node_t
+    {
+        uint64_t key = 0;
+        int parent = -1;
+        int slot = -1;
+        uint64_t last_use = 0;
+        std::unordered_map<uint64_t, int> children;
+    };
+
+    size_t _row_bytes = 0;
+    std::vector<char> _arena;
+    std::vector<int> _free_slots;
+    std::vector<node_t> _nodes; // 第 0 个为根，不占 slot
+    std::vector<int> _free_nodes;
+    uint64_t _clock = 0;
+    stats_t _stats;
+
+    int child(int node, uint64_t key);
+    // 淘汰一个不在 keep 路径上的最久没用到的叶子，没有可淘汰的返回 false
+    bool evict(const std::vector<int> &keep);
+
+public:
+    // capacity 为 arena 的字节数，row_bytes 为每个 token 的数据大小
+    bool Init(size_t capacity, size_t row_bytes);
+    void Clear();
+    bool Enabled() { return Capacity() > 0; }
+    int Size() { return (int)(_nodes.size() - _free_nodes.size()) - (_nodes.empty() ? 0 : 1); }
+    int Capacity() { return _row_bytes ? (int)(_arena.size() / _row_bytes) : 0; }
+
+    // 返回从头开始最多 max_len 个 key 中命中的长度，rows 为各个位置的数据
+    int Match(const std::vector<uint64_t> &keys, int max_len, std::vector<const char *> &rows);
+    // 保存 keys 的前 n 个位置，已有的位置只更新使用时间，fill(i, dst) 写入第 i 个位置的数据；返回新保存的个数
+    int Insert(const std::vector<uint64_t> &keys, int n, std::function<void(int, char *)> fill);
+
+    const stats_t &Stats() { return _stats; }
+
+    static uint64_t Hash(const void *data, size_t size, uint64_t seed = 0);
+};
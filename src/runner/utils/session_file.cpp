@@ -0,0 +1,63 @@
+#include "session_file.hpp"
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include "bfloat16.hpp"
+
+size_t session_kv_block_size(int dtype, int rows, int row_len)
+{
+    if (dtype == AX_SESSION_KV_INT8)
+    {
+        return rows * sizeof(float) + (size_t)rows * row_len;
+    }
+    return (size_t)rows * row_len * sizeof(unsigned short);
+}
+
+void session_pack_kv(int dtype, const unsigned short *src, int rows, int row_len, char *dst)
+{
+    if (dtype != AX_SESSION_KV_INT8)
+    {
+        memcpy(dst, src, (size_t)rows * row_len * sizeof(unsigned short));
+        return;
+    }
+    float *scales = (float *)dst;
+    int8_t *q = (int8_t *)(dst + rows * sizeof(float));
+    std::vector<float> row(row_len);
+    for (int i = 0; i < rows; i++)
+    {
+        float absmax = 0;
+        for (int j = 0; j < row_len; j++)
+        {
+            row[j] = bfloat16(src[(size_t)i * row_len + j]).fp32();
+            absmax = fmaxf(absmax, fabsf(row[j]));
+        }
+        float scale = absmax / 127.f;
+        float inv = scale > 0 ? 1.f / scale : 0;
+        scales[i] = scale;
+        for (int j = 0; j < row_len; j++)
+        {
+            q[(size_t)i * row_len + j] = (int8_t)lrintf(row[j] * inv);
+        }
+    }
+}
+
+void session_unpack_kv(int dtype, const char *src, int rows, int row_len, unsigned short *dst)
+{
+    if (dtype != AX_SESSION_KV_INT8)
+    {
+        memcpy(dst, src, (size_t)rows * row_len * sizeof(unsigned short));
+        return;
+    }
+    const float *scales = (const float *)src;
+    const int8_t *q = (const int8_t *)(src + rows * sizeof(float));
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < row_len; j++)
+        {
+            bfloat16 v = q[(size_t)i * row_len + j] * scales[i];
+            dst[(size_t)i * row_len + j] = v.data;
+        }
+    }
+}
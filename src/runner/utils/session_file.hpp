@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// 保存到磁盘的会话，小端:
+//   header | meta json(模型文件的 key、采样器的随机数状态) | 会话中生成的 token(int32) | 按 64 对齐的 kv
+// kv 按层依次存放 K、V 各 kv_len 行；int8 时每块先存 kv_len 个 float scale(每行的 absmax / 127)，再存量化后的行
+#define AX_SESSION_MAGIC "AXLLMSES"
+#define AX_SESSION_VERSION 1
+#define AX_SESSION_ALIGN 64
+
+enum
+{
+    AX_SESSION_KV_BF16 = 0,
+    AX_SESSION_KV_INT8 = 1,
+};
+
+struct ax_session_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t kv_dtype;
+    uint32_t axmodel_num;
+    uint32_t kv_cache_size; // 每行的元素个数
+    uint32_t kv_len;        // kv cache 中有效的行数，即会话长度，decode mask 中前 kv_len 个位置打开
+    int32_t pending_token;
+    uint32_t token_num;
+    uint32_t reserved;
+    uint64_t meta_size;
+    uint64_t kv_offset;
+    uint64_t kv_size;
+};
+
+static_assert(sizeof(ax_session_header_t) == 64, "session header layout");
+
+// 一个 K 或 V 块(rows 行)在文件中的大小
+size_t session_kv_block_size(int dtype, int rows, int row_len);
+// bf16 的 rows 行转成文件中的块，dst 大小为 session_kv_block_size
+void session_pack_kv(int dtype, const unsigned short *src, int rows, int row_len, char *dst);
+void session_unpack_kv(int dtype, const char *src, int rows, int row_len, unsigned short *dst);